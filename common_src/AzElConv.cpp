@@ -0,0 +1,394 @@
+#include "AzElConv.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AZEL_X86
+#include <immintrin.h>
+#endif
+
+// приведение к [-pi/4, pi/4]: x - q*pi/2, pi/2 = PIO2_1 + PIO2_2 + PIO2_3
+static const double twoOverPi = 6.36619772367581382433e-01;
+static const double PIO2_1 = 1.57079625129699707031e+00;
+static const double PIO2_2 = 7.54978941586159635335e-08;
+static const double PIO2_3 = 5.39030285815811905290e-15;
+// коэффициенты cephes sin.c
+static const double S0 = 1.58962301576546568060e-10;
+static const double S1 = -2.50507477628578072866e-08;
+static const double S2 = 2.75573136213857245213e-06;
+static const double S3 = -1.98412698295895385996e-04;
+static const double S4 = 8.33333333332211858878e-03;
+static const double S5 = -1.66666666666666307295e-01;
+static const double C0 = -1.13585365213876817300e-11;
+static const double C1 = 2.08757008419747316778e-09;
+static const double C2 = -2.75573141792967388112e-07;
+static const double C3 = 2.48015872888517045348e-05;
+static const double C4 = -1.38888888888730564116e-03;
+static const double C5 = 4.16666666666665929218e-02;
+
+// коэффициенты cephes atan.c
+static const double P0 = -8.750608600031904122785e-01;
+static const double P1 = -1.615753718733365076637e+01;
+static const double P2 = -7.500855792314704667340e+01;
+static const double P3 = -1.228866684490136173410e+02;
+static const double P4 = -6.485021904942025371773e+01;
+static const double Q0 = 2.485846490142306297962e+01;
+static const double Q1 = 1.650270098316988542046e+02;
+static const double Q2 = 4.328810604912902668951e+02;
+static const double Q3 = 4.853903996359136964868e+02;
+static const double Q4 = 1.945506571482613964425e+02;
+// pi/4, pi/2, pi с младшими частями
+static const double PIO4_HI = 7.85398163397448278999e-01;
+static const double PIO4_LO = 3.06161699786838301793e-17;
+static const double PIO2_HI = 1.57079632679489655800e+00;
+static const double PIO2_LO = 6.12323399573676603587e-17;
+static const double PI_HI = 3.14159265358979311600e+00;
+static const double PI_LO = 1.22464679914735317723e-16;
+
+static void toVecScalar(const double *az, const double *el, Vec3d *out,
+                        int n)
+{
+    for (int i = 0; i < n; ++i)
+        out[i] = AzElConv::toVec(az[i], el[i]);
+}
+
+static void toAzElScalar(const Vec3d *v, double *az, double *el, int n)
+{
+    for (int i = 0; i < n; ++i)
+        AzElConv::toAzEl(v[i], az[i], el[i]);
+}
+
+#ifdef AZEL_X86
+
+__attribute__((target("sse2")))
+static inline void sincos2(__m128d x, __m128d &s, __m128d &c)
+{
+    const __m128i qi = _mm_cvtpd_epi32(_mm_mul_pd(x, _mm_set1_pd(twoOverPi)));
+    const __m128d q = _mm_cvtepi32_pd(qi);
+    __m128d z = _mm_sub_pd(x, _mm_mul_pd(q, _mm_set1_pd(PIO2_1)));
+    z = _mm_sub_pd(z, _mm_mul_pd(q, _mm_set1_pd(PIO2_2)));
+    z = _mm_sub_pd(z, _mm_mul_pd(q, _mm_set1_pd(PIO2_3)));
+    const __m128d zz = _mm_mul_pd(z, z);
+
+    __m128d ps = _mm_set1_pd(S0);
+    ps = _mm_add_pd(_mm_mul_pd(ps, zz), _mm_set1_pd(S1));
+    ps = _mm_add_pd(_mm_mul_pd(ps, zz), _mm_set1_pd(S2));
+    ps = _mm_add_pd(_mm_mul_pd(ps, zz), _mm_set1_pd(S3));
+    ps = _mm_add_pd(_mm_mul_pd(ps, zz), _mm_set1_pd(S4));
+    ps = _mm_add_pd(_mm_mul_pd(ps, zz), _mm_set1_pd(S5));
+    ps = _mm_add_pd(z, _mm_mul_pd(_mm_mul_pd(ps, zz), z));
+    __m128d pc = _mm_set1_pd(C0);
+    pc = _mm_add_pd(_mm_mul_pd(pc, zz), _mm_set1_pd(C1));
+    pc = _mm_add_pd(_mm_mul_pd(pc, zz), _mm_set1_pd(C2));
+    pc = _mm_add_pd(_mm_mul_pd(pc, zz), _mm_set1_pd(C3));
+    pc = _mm_add_pd(_mm_mul_pd(pc, zz), _mm_set1_pd(C4));
+    pc = _mm_add_pd(_mm_mul_pd(pc, zz), _mm_set1_pd(C5));
+    pc = _mm_add_pd(_mm_sub_pd(_mm_set1_pd(1.), _mm_mul_pd(zz, _mm_set1_pd(.5))),
+                    _mm_mul_pd(_mm_mul_pd(pc, zz), zz));
+
+    // квадрант q в обеих половинах 64-битных элементов
+    const __m128i q64 = _mm_shuffle_epi32(qi, _MM_SHUFFLE(1, 1, 0, 0));
+    const __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+    const __m128d swap = _mm_castsi128_pd(
+        _mm_cmpeq_epi32(_mm_and_si128(q64, one), one));
+    const __m128d sv = _mm_or_pd(_mm_and_pd(swap, pc), _mm_andnot_pd(swap, ps));
+    const __m128d cv = _mm_or_pd(_mm_and_pd(swap, ps), _mm_andnot_pd(swap, pc));
+    // знак: sin при (q & 2), cos при ((q + 1) & 2), бит 1 -> бит 63
+    const __m128i sgnS = _mm_slli_epi64(_mm_and_si128(q64, two), 62);
+    const __m128i sgnC = _mm_slli_epi64(
+        _mm_and_si128(_mm_add_epi32(q64, one), two), 62);
+    s = _mm_xor_pd(sv, _mm_castsi128_pd(sgnS));
+    c = _mm_xor_pd(cv, _mm_castsi128_pd(sgnC));
+}
+
+__attribute__((target("sse2")))
+static void toVecSse2(const double *az, const double *el, Vec3d *out, int n)
+{
+    double x[2], y[2], z[2];
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d sa, ca, se, ce;
+        sincos2(_mm_loadu_pd(az + i), sa, ca);
+        sincos2(_mm_loadu_pd(el + i), se, ce);
+        _mm_storeu_pd(x, _mm_sub_pd(_mm_setzero_pd(), _mm_mul_pd(ca, ce)));
+        _mm_storeu_pd(y, _mm_mul_pd(sa, ce));
+        _mm_storeu_pd(z, se);
+        out[i].set(x[0], y[0], z[0]);
+        out[i + 1].set(x[1], y[1], z[1]);
+    }
+    toVecScalar(az + i, el + i, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline void sincos4(__m256d x, __m256d &s, __m256d &c)
+{
+    const __m128i qi = _mm256_cvtpd_epi32(
+        _mm256_mul_pd(x, _mm256_set1_pd(twoOverPi)));
+    const __m256d q = _mm256_cvtepi32_pd(qi);
+    __m256d z = _mm256_sub_pd(x, _mm256_mul_pd(q, _mm256_set1_pd(PIO2_1)));
+    z = _mm256_sub_pd(z, _mm256_mul_pd(q, _mm256_set1_pd(PIO2_2)));
+    z = _mm256_sub_pd(z, _mm256_mul_pd(q, _mm256_set1_pd(PIO2_3)));
+    const __m256d zz = _mm256_mul_pd(z, z);
+
+    __m256d ps = _mm256_set1_pd(S0);
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, zz), _mm256_set1_pd(S1));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, zz), _mm256_set1_pd(S2));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, zz), _mm256_set1_pd(S3));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, zz), _mm256_set1_pd(S4));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, zz), _mm256_set1_pd(S5));
+    ps = _mm256_add_pd(z, _mm256_mul_pd(_mm256_mul_pd(ps, zz), z));
+    __m256d pc = _mm256_set1_pd(C0);
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, zz), _mm256_set1_pd(C1));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, zz), _mm256_set1_pd(C2));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, zz), _mm256_set1_pd(C3));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, zz), _mm256_set1_pd(C4));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, zz), _mm256_set1_pd(C5));
+    pc = _mm256_add_pd(
+        _mm256_sub_pd(_mm256_set1_pd(1.), _mm256_mul_pd(zz, _mm256_set1_pd(.5))),
+        _mm256_mul_pd(_mm256_mul_pd(pc, zz), zz));
+
+    const __m256i q64 = _mm256_cvtepi32_epi64(qi);
+    const __m256i one = _mm256_set1_epi64x(1), two = _mm256_set1_epi64x(2);
+    const __m256d swap = _mm256_castsi256_pd(
+        _mm256_cmpeq_epi64(_mm256_and_si256(q64, one), one));
+    const __m256d sv = _mm256_blendv_pd(ps, pc, swap);
+    const __m256d cv = _mm256_blendv_pd(pc, ps, swap);
+    const __m256i sgnS = _mm256_slli_epi64(_mm256_and_si256(q64, two), 62);
+    const __m256i sgnC = _mm256_slli_epi64(
+        _mm256_and_si256(_mm256_add_epi64(q64, one), two), 62);
+    s = _mm256_xor_pd(sv, _mm256_castsi256_pd(sgnS));
+    c = _mm256_xor_pd(cv, _mm256_castsi256_pd(sgnC));
+}
+
+__attribute__((target("avx2")))
+static void toVecAvx2(const double *az, const double *el, Vec3d *out, int n)
+{
+    double x[4], y[4], z[4];
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d sa, ca, se, ce;
+        sincos4(_mm256_loadu_pd(az + i), sa, ca);
+        sincos4(_mm256_loadu_pd(el + i), se, ce);
+        _mm256_storeu_pd(x, _mm256_sub_pd(_mm256_setzero_pd(),
+                                          _mm256_mul_pd(ca, ce)));
+        _mm256_storeu_pd(y, _mm256_mul_pd(sa, ce));
+        _mm256_storeu_pd(z, se);
+        for (int k = 0; k < 4; ++k)
+            out[i + k].set(x[k], y[k], z[k]);
+    }
+    toVecSse2(az + i, el + i, out + i, n - i);
+}
+
+/* atan2 без ветвлений: a = min(|x|,|y|)/max(|x|,|y|) из [0, 1], при a > 0.66
+ * приведение (a - 1)/(a + 1) + pi/4, затем отражения pi/2 - r (|y| > |x|),
+ * pi - r (x < 0) и знак y.
+ */
+__attribute__((target("sse2")))
+static inline __m128d blend2(__m128d m, __m128d a, __m128d b)
+{
+    return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b));
+}
+
+__attribute__((target("sse2")))
+static inline __m128d atan2_2(__m128d y, __m128d x)
+{
+    const __m128d signMask = _mm_set1_pd(-0.);
+    const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1.);
+    const __m128d ax = _mm_andnot_pd(signMask, x);
+    const __m128d ay = _mm_andnot_pd(signMask, y);
+    const __m128d swap = _mm_cmpgt_pd(ay, ax);
+    const __m128d den = _mm_max_pd(ax, ay);
+    // 0/0 даёт 0
+    const __m128d a = _mm_and_pd(_mm_div_pd(_mm_min_pd(ax, ay), den),
+                                 _mm_cmpgt_pd(den, zero));
+    const __m128d big = _mm_cmpgt_pd(a, _mm_set1_pd(0.66));
+    const __m128d t = blend2(big, _mm_div_pd(_mm_sub_pd(a, one),
+                                             _mm_add_pd(a, one)), a);
+    const __m128d z = _mm_mul_pd(t, t);
+    __m128d p = _mm_set1_pd(P0);
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(P1));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(P2));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(P3));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(P4));
+    __m128d q = _mm_add_pd(z, _mm_set1_pd(Q0));
+    q = _mm_add_pd(_mm_mul_pd(q, z), _mm_set1_pd(Q1));
+    q = _mm_add_pd(_mm_mul_pd(q, z), _mm_set1_pd(Q2));
+    q = _mm_add_pd(_mm_mul_pd(q, z), _mm_set1_pd(Q3));
+    q = _mm_add_pd(_mm_mul_pd(q, z), _mm_set1_pd(Q4));
+    __m128d r = _mm_add_pd(t, _mm_mul_pd(t, _mm_div_pd(_mm_mul_pd(z, p), q)));
+    r = blend2(big, _mm_add_pd(_mm_set1_pd(PIO4_HI),
+                               _mm_add_pd(r, _mm_set1_pd(PIO4_LO))), r);
+    r = blend2(swap, _mm_add_pd(_mm_sub_pd(_mm_set1_pd(PIO2_HI), r),
+                                _mm_set1_pd(PIO2_LO)), r);
+    r = blend2(_mm_cmplt_pd(x, zero),
+               _mm_add_pd(_mm_sub_pd(_mm_set1_pd(PI_HI), r),
+                          _mm_set1_pd(PI_LO)), r);
+    return _mm_or_pd(r, _mm_and_pd(y, signMask));
+}
+
+__attribute__((target("sse2")))
+static void toAzElSse2(const Vec3d *v, double *az, double *el, int n)
+{
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        const __m128d x = _mm_set_pd(v[i + 1][0], v[i][0]);
+        const __m128d y = _mm_set_pd(v[i + 1][1], v[i][1]);
+        const __m128d z = _mm_set_pd(v[i + 1][2], v[i][2]);
+        const __m128d h = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(x, x),
+                                                 _mm_mul_pd(y, y)));
+        _mm_storeu_pd(az + i, atan2_2(y, _mm_sub_pd(_mm_setzero_pd(), x)));
+        _mm_storeu_pd(el + i, atan2_2(z, h));
+    }
+    toAzElScalar(v + i, az + i, el + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256d atan2_4(__m256d y, __m256d x)
+{
+    const __m256d signMask = _mm256_set1_pd(-0.);
+    const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.);
+    const __m256d ax = _mm256_andnot_pd(signMask, x);
+    const __m256d ay = _mm256_andnot_pd(signMask, y);
+    const __m256d swap = _mm256_cmp_pd(ay, ax, _CMP_GT_OQ);
+    const __m256d den = _mm256_max_pd(ax, ay);
+    const __m256d a = _mm256_and_pd(_mm256_div_pd(_mm256_min_pd(ax, ay), den),
+                                    _mm256_cmp_pd(den, zero, _CMP_GT_OQ));
+    const __m256d big = _mm256_cmp_pd(a, _mm256_set1_pd(0.66), _CMP_GT_OQ);
+    const __m256d t = _mm256_blendv_pd(a, _mm256_div_pd(_mm256_sub_pd(a, one),
+                                                        _mm256_add_pd(a, one)),
+                                       big);
+    const __m256d z = _mm256_mul_pd(t, t);
+    __m256d p = _mm256_set1_pd(P0);
+    p = _mm256_add_pd(_mm256_mul_pd(p, z), _mm256_set1_pd(P1));
+    p = _mm256_add_pd(_mm256_mul_pd(p, z), _mm256_set1_pd(P2));
+    p = _mm256_add_pd(_mm256_mul_pd(p, z), _mm256_set1_pd(P3));
+    p = _mm256_add_pd(_mm256_mul_pd(p, z), _mm256_set1_pd(P4));
+    __m256d q = _mm256_add_pd(z, _mm256_set1_pd(Q0));
+    q = _mm256_add_pd(_mm256_mul_pd(q, z), _mm256_set1_pd(Q1));
+    q = _mm256_add_pd(_mm256_mul_pd(q, z), _mm256_set1_pd(Q2));
+    q = _mm256_add_pd(_mm256_mul_pd(q, z), _mm256_set1_pd(Q3));
+    q = _mm256_add_pd(_mm256_mul_pd(q, z), _mm256_set1_pd(Q4));
+    __m256d r = _mm256_add_pd(t, _mm256_mul_pd(t, _mm256_div_pd(
+                                  _mm256_mul_pd(z, p), q)));
+    r = _mm256_blendv_pd(r, _mm256_add_pd(_mm256_set1_pd(PIO4_HI),
+                            _mm256_add_pd(r, _mm256_set1_pd(PIO4_LO))), big);
+    r = _mm256_blendv_pd(r, _mm256_add_pd(_mm256_sub_pd(
+                            _mm256_set1_pd(PIO2_HI), r),
+                            _mm256_set1_pd(PIO2_LO)), swap);
+    r = _mm256_blendv_pd(r, _mm256_add_pd(_mm256_sub_pd(
+                            _mm256_set1_pd(PI_HI), r), _mm256_set1_pd(PI_LO)),
+                         _mm256_cmp_pd(x, zero, _CMP_LT_OQ));
+    return _mm256_or_pd(r, _mm256_and_pd(y, signMask));
+}
+
+__attribute__((target("avx2")))
+static void toAzElAvx2(const Vec3d *v, double *az, double *el, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m256d x = _mm256_set_pd(v[i + 3][0], v[i + 2][0],
+                                        v[i + 1][0], v[i][0]);
+        const __m256d y = _mm256_set_pd(v[i + 3][1], v[i + 2][1],
+                                        v[i + 1][1], v[i][1]);
+        const __m256d z = _mm256_set_pd(v[i + 3][2], v[i + 2][2],
+                                        v[i + 1][2], v[i][2]);
+        const __m256d h = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(x, x),
+                                                       _mm256_mul_pd(y, y)));
+        _mm256_storeu_pd(az + i, atan2_4(y, _mm256_sub_pd(
+                                            _mm256_setzero_pd(), x)));
+        _mm256_storeu_pd(el + i, atan2_4(z, h));
+    }
+    toAzElSse2(v + i, az + i, el + i, n - i);
+}
+
+#endif // AZEL_X86
+
+bool AzElConv::hasKernel(Kernel k)
+{
+    switch (k)
+    {
+        case Scalar:
+            return true;
+#ifdef AZEL_X86
+        case Sse2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2");
+        case Avx2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+AzElConv::Kernel AzElConv::bestKernel(void)
+{
+    static const Kernel best = hasKernel(Avx2)? Avx2:
+                               hasKernel(Sse2)? Sse2: Scalar;
+    return best;
+}
+
+const char* AzElConv::kernelName(Kernel k)
+{
+    switch (k)
+    {
+        case Sse2: return "sse2";
+        case Avx2: return "avx2";
+        default:   return "scalar";
+    }
+}
+
+void AzElConv::toVec(const double *az, const double *el, Vec3d *out, int n)
+{
+    toVec(bestKernel(), az, el, out, n);
+}
+
+void AzElConv::toVec(Kernel k, const double *az, const double *el,
+                     Vec3d *out, int n)
+{
+    if (k != Scalar && !hasKernel(k))
+        k = Scalar;
+    switch (k)
+    {
+#ifdef AZEL_X86
+        case Sse2:
+            toVecSse2(az, el, out, n);
+            break;
+        case Avx2:
+            toVecAvx2(az, el, out, n);
+            break;
+#endif
+        default:
+            toVecScalar(az, el, out, n);
+            break;
+    }
+}
+
+void AzElConv::toAzEl(const Vec3d *v, double *az, double *el, int n)
+{
+    toAzEl(bestKernel(), v, az, el, n);
+}
+
+void AzElConv::toAzEl(Kernel k, const Vec3d *v, double *az, double *el,
+                      int n)
+{
+    if (k != Scalar && !hasKernel(k))
+        k = Scalar;
+    switch (k)
+    {
+#ifdef AZEL_X86
+        case Sse2:
+            toAzElSse2(v, az, el, n);
+            break;
+        case Avx2:
+            toAzElAvx2(v, az, el, n);
+            break;
+#endif
+        default:
+            toAzElScalar(v, az, el, n);
+            break;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef _AZELCONV_HPP_
+#define _AZELCONV_HPP_
+
+#include "VecMath.hpp"
+#include <math.h>
+
+/*! \class AzElConv
+ *  \brief Conversion between radar azimuth/elevation and Stellarium vectors.
+ *
+ *  Unit vector of the direction (az, el), radians:
+ *  (-cos(az)*cos(el), sin(az)*cos(el), sin(el)). It equals the normalized
+ *  (-cos(az), sin(az), tan(el)) for |el| < pi/2 but needs neither tan nor
+ *  normalization, so el = +-pi/2 is not a special case. The inverse is
+ *  az = atan2(y, -x), el = atan2(z, sqrt(x*x + y*y)); the vector need not
+ *  be normalized.
+ *
+ *  The batch versions use SIMD kernels with cephes-style sin/cos and atan
+ *  polynomials (error below 1e-15 for |az|, |el| < 1e3); the kernel is
+ *  chosen at run time from the CPU features.
+ */
+class AzElConv
+{
+public:
+    enum Kernel
+    {
+        Scalar,     // sin/cos из libm
+        Sse2,
+        Avx2
+    };
+
+    static Vec3d toVec(double az, double el)
+    {
+        const double ce = cos(el);
+        return Vec3d(-cos(az)*ce, sin(az)*ce, sin(el));
+    }
+    //! n directions, best kernel of the CPU
+    static void toVec(const double *az, const double *el, Vec3d *out, int n);
+    //! n directions with the given kernel, Scalar if it is not supported
+    static void toVec(Kernel k, const double *az, const double *el,
+                      Vec3d *out, int n);
+
+    //! az in [-pi, pi], el in [-pi/2, pi/2]
+    static void toAzEl(const Vec3d &v, double &az, double &el)
+    {
+        az = atan2(v[1], 0. - v[0]);
+        el = atan2(v[2], sqrt(v[0]*v[0] + v[1]*v[1]));
+    }
+    static void toAzEl(const Vec3d *v, double *az, double *el, int n);
+    static void toAzEl(Kernel k, const Vec3d *v, double *az, double *el,
+                       int n);
+
+    static bool hasKernel(Kernel k);
+    static Kernel bestKernel(void);
+    static const char* kernelName(Kernel k);
+};
+
+#endif // _AZELCONV_HPP_
@@ -0,0 +1,73 @@
+#include "DbScheduler.hpp"
+
+DbScheduler::DbScheduler()
+{
+}
+
+void DbScheduler::add(int id, double period, int priority)
+{
+    Source s = {id, priority, period, 0.};
+    std::vector<Source>::iterator it = sources.begin();
+    while (it != sources.end() && it->priority >= priority)
+        ++it;
+    sources.insert(it, s);
+}
+
+void DbScheduler::setPeriod(int id, double period)
+{
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        if (sources[i].id != id)
+            continue;
+        // срок сдвигается на разницу периодов
+        sources[i].due += period - sources[i].period;
+        sources[i].period = period;
+    }
+}
+
+void DbScheduler::clear(void)
+{
+    sources.clear();
+}
+
+void DbScheduler::kick(void)
+{
+    for (size_t i = 0; i < sources.size(); ++i)
+        sources[i].due = 0.;
+}
+
+void DbScheduler::kick(int id)
+{
+    for (size_t i = 0; i < sources.size(); ++i)
+        if (sources[i].id == id)
+            sources[i].due = 0.;
+}
+
+int DbScheduler::takeDue(double now, std::vector<int> &ids)
+{
+    int n = 0;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        Source &s = sources[i];
+        if (s.due > now)
+            continue;
+        ids.push_back(s.id);
+        ++n;
+        // пропущенные сроки не накапливаются
+        s.due += s.period;
+        if (s.due <= now)
+            s.due = now + s.period;
+    }
+    return n;
+}
+
+double DbScheduler::nextDue(void) const
+{
+    if (sources.empty())
+        return -1.;
+    double t = sources[0].due;
+    for (size_t i = 1; i < sources.size(); ++i)
+        if (sources[i].due < t)
+            t = sources[i].due;
+    return t;
+}
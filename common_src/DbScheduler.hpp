@@ -0,0 +1,45 @@
+#ifndef _DBSCHEDULER_HPP_
+#define _DBSCHEDULER_HPP_
+
+#include <stddef.h>
+#include <vector>
+
+/*! \class DbScheduler
+ *  \brief Deadline scheduler of the data sources polled by the DB thread.
+ *
+ *  Every source has its own refresh period, priority and next-due time.
+ *  takeDue() returns the sources whose time has come, higher priority
+ *  first, and moves their next-due time one period ahead. Time is in
+ *  seconds of a monotonic clock. The class is not thread-safe, the owner
+ *  guards it with its own mutex.
+ */
+class DbScheduler
+{
+public:
+    DbScheduler();
+
+    void add(int id, double period, int priority);
+    void setPeriod(int id, double period);
+    void clear(void);
+    //! make all sources due immediately
+    void kick(void);
+    //! make one source due immediately
+    void kick(int id);
+
+    //! append due sources to ids in priority order, returns their number
+    int takeDue(double now, std::vector<int> &ids);
+    //! earliest next-due time, or a negative value when there are no sources
+    double nextDue(void) const;
+
+private:
+    struct Source
+    {
+        int id;
+        int priority;
+        double period;
+        double due;
+    };
+    std::vector<Source> sources;    // sorted by priority, higher first
+};
+
+#endif // _DBSCHEDULER_HPP_
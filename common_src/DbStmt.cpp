@@ -0,0 +1,140 @@
+#include "DbStmt.hpp"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdexcept>
+#include <mysql/errmsg.h>
+#include <mysql/mysqld_error.h>
+#include <vu_tools/vu_tools.h>
+
+DbStmt::DbStmt()
+  : conn(NULL)
+  , stmt(NULL)
+{
+}
+
+DbStmt::~DbStmt()
+{
+    close();
+}
+
+void DbStmt::prepare(MYSQL *mysql, const std::string &query)
+{
+    close();
+    conn = mysql;
+    text = query;
+    stmt = mysql_stmt_init(conn);
+    if (!stmt)
+        throwError("can't init statement", __LINE__);
+    if (mysql_stmt_prepare(stmt, text.c_str(), text.size()))
+    {
+        std::string err;
+        char buf[1024];
+        snprintf(buf, 1024, "[%s:%d] Error: can't prepare statement:\n",
+                 _FILE_, __LINE__);
+        err = buf;
+        err += mysql_stmt_error(stmt);
+        mysql_stmt_close(stmt);
+        stmt = NULL;
+        throw std::runtime_error(err);
+    }
+}
+
+void DbStmt::close(void)
+{
+    if (stmt)
+    {
+        mysql_stmt_close(stmt);
+        stmt = NULL;
+    }
+}
+
+void DbStmt::reset(void)
+{
+    close();
+    params.clear();
+    results.clear();
+    resNull.clear();
+    text.clear();
+}
+
+void DbStmt::addParam(enum_field_types type, void *buf, bool isUnsigned)
+{
+    MYSQL_BIND b;
+    memset(&b, 0, sizeof b);
+    b.buffer_type = type;
+    b.buffer = buf;
+    b.is_unsigned = isUnsigned;
+    params.push_back(b);
+}
+
+void DbStmt::addResult(enum_field_types type, void *buf, bool isUnsigned)
+{
+    MYSQL_BIND b;
+    memset(&b, 0, sizeof b);
+    b.buffer_type = type;
+    b.buffer = buf;
+    b.is_unsigned = isUnsigned;
+    results.push_back(b);
+    resNull.push_back(0);
+}
+
+void DbStmt::execute(void)
+{
+    if (!stmt)
+        throwError("statement is not prepared", __LINE__);
+    if (tryExecute())
+        return;
+    // после переподключения к серверу подготовленные запросы недействительны,
+    // после mysql_close() соединения запрос отсоединён от него (CR_STMT_CLOSED)
+    const unsigned int err = mysql_stmt_errno(stmt);
+    if (err != CR_SERVER_GONE_ERROR && err != CR_SERVER_LOST &&
+        err != ER_UNKNOWN_STMT_HANDLER && err != CR_STMT_CLOSED)
+        throwError("can't execute statement", __LINE__);
+    mysql_ping(conn);
+    prepare(conn, std::string(text));
+    if (!tryExecute())
+        throwError("can't execute statement", __LINE__);
+}
+
+bool DbStmt::tryExecute(void)
+{
+    if (!params.empty() && mysql_stmt_bind_param(stmt, &params[0]))
+        return false;
+    if (mysql_stmt_execute(stmt))
+        return false;
+    if (!results.empty())
+    {
+        for (size_t i = 0; i < results.size(); ++i)
+            results[i].is_null = &resNull[i];
+        if (mysql_stmt_bind_result(stmt, &results[0]))
+            return false;
+    }
+    return true;
+}
+
+bool DbStmt::fetch(void)
+{
+    const int res = mysql_stmt_fetch(stmt);
+    if (res == 1)
+        throwError("can't fetch row", __LINE__);
+    return res != MYSQL_NO_DATA;
+}
+
+void DbStmt::freeResult(void)
+{
+    if (stmt)
+        mysql_stmt_free_result(stmt);
+}
+
+void DbStmt::throwError(const char *what, int line) const
+{
+    char buf[1024];
+    snprintf(buf, 1024, "[%s:%d] Error: %s:\n", _FILE_, line, what);
+    std::string err(buf);
+    if (stmt)
+        err += mysql_stmt_error(stmt);
+    else if (conn)
+        err += mysql_error(conn);
+    throw std::runtime_error(err);
+}
@@ -0,0 +1,51 @@
+#ifndef _DBSTMT_HPP_
+#define _DBSTMT_HPP_
+
+#include <mysql/mysql.h>
+#include <string>
+#include <vector>
+
+/*! \class DbStmt
+ *  \brief Server-side prepared statement with bound numeric buffers.
+ *
+ *  Parameters and result columns are bound once to caller's variables
+ *  with addParam()/addResult(); execute() sends current parameter values
+ *  with the binary protocol and fetch() fills the result variables row by
+ *  row. Errors are reported with std::runtime_error.
+ */
+class DbStmt
+{
+    DbStmt(const DbStmt&);
+    const DbStmt& operator=(const DbStmt&);
+
+public:
+    DbStmt();
+    ~DbStmt();
+
+    bool isPrepared(void) const {return stmt != NULL;}
+    const std::string& query(void) const {return text;}
+    void prepare(MYSQL *mysql, const std::string &query);
+    void close(void);
+    // закрытие запроса и сброс привязанных параметров и результатов
+    void reset(void);
+
+    void addParam(enum_field_types type, void *buf, bool isUnsigned = false);
+    void addResult(enum_field_types type, void *buf, bool isUnsigned = false);
+
+    void execute(void);
+    bool fetch(void);
+    void freeResult(void);
+
+private:
+    MYSQL *conn;
+    MYSQL_STMT *stmt;
+    std::string text;
+    std::vector<MYSQL_BIND> params;
+    std::vector<MYSQL_BIND> results;
+    std::vector<my_bool> resNull;
+
+    bool tryExecute(void);
+    void throwError(const char *what, int line) const;
+};
+
+#endif // _DBSTMT_HPP_
@@ -0,0 +1,261 @@
+#include "FeedLog.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+#include <vu_tools/vu_tools.h>
+
+static const char feedMagic[8] = "SATFEED";
+// шаг увеличения файла
+static const uint64_t growStep = (uint64_t)64 << 20;
+static const uint64_t idxPeriod = 1000000000ull;    // нс
+
+static std::string sysError(const char *what, const std::string &path,
+                            int line)
+{
+    char buf[1024];
+    snprintf(buf, 1024, "[%s:%d] Error: %s %s: %s", _FILE_, line, what,
+             path.c_str(), strerror(errno));
+    return buf;
+}
+
+uint64_t FeedLog::monoNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+FeedLog::FeedLog(const std::string &p)
+  : path(p)
+  , fd(-1)
+  , idx(NULL)
+  , map(NULL)
+  , cap(0)
+  , used(0)
+  , lastIdxMono(0)
+  , nRecords(0)
+  , failed(false)
+{
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error(sysError("can't create", path, __LINE__));
+    idx = fopen((path + ".idx").c_str(), "wb");
+    if (!idx)
+    {
+        const std::string err = sysError("can't create", path + ".idx",
+                                         __LINE__);
+        ::close(fd);
+        throw std::runtime_error(err);
+    }
+    if (!grow(sizeof(FileHeader)))
+    {
+        const std::string err = sysError("can't map", path, __LINE__);
+        close();
+        throw std::runtime_error(err);
+    }
+    FileHeader h;
+    memcpy(h.magic, feedMagic, sizeof(h.magic));
+    h.version = version;
+    h.headerSize = sizeof(FileHeader);
+    memcpy(map, &h, sizeof(h));
+    used = sizeof(h);
+    pthread_mutex_init(&lock, NULL);
+}
+
+FeedLog::~FeedLog()
+{
+    close();
+    pthread_mutex_destroy(&lock);
+}
+
+void FeedLog::close(void)
+{
+    if (map)
+    {
+        munmap(map, cap);
+        map = NULL;
+    }
+    if (fd >= 0)
+    {
+        // хвост последнего шага не нужен
+        if (ftruncate(fd, used))
+            fprintf(stderr, "%s\n", sysError("can't truncate", path,
+                                             __LINE__).c_str());
+        ::close(fd);
+        fd = -1;
+    }
+    if (idx)
+    {
+        fclose(idx);
+        idx = NULL;
+    }
+}
+
+bool FeedLog::grow(uint64_t need)
+{
+    if (need <= cap)
+        return true;
+    const uint64_t newCap = (need + growStep - 1) / growStep * growStep;
+    if (ftruncate(fd, newCap))
+        return false;
+    if (map)
+        munmap(map, cap);
+    map = (char*)mmap(NULL, newCap, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        map = NULL;
+        cap = 0;
+        return false;
+    }
+    cap = newCap;
+    return true;
+}
+
+bool FeedLog::write(RecType type, uint32_t channel, uint64_t stel,
+                    const void *p1, size_t n1, const void *p2, size_t n2)
+{
+    RecHeader h;
+    h.type = type;
+    h.channel = channel;
+    h.stel = stel;
+    h.size = (uint32_t)(n1 + n2);
+    h.reserved = 0;
+    const uint64_t recSize = sizeof(h) + align8(n1 + n2);
+
+    pthread_mutex_lock(&lock);
+    if (failed)
+    {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+    if (!grow(used + recSize))
+    {
+        fprintf(stderr, "%s, recording stopped\n",
+                sysError("can't grow", path, __LINE__).c_str());
+        failed = true;
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+    // время берётся под блокировкой, чтобы записи шли по возрастанию
+    h.mono = monoNs();
+    char *dst = map + used;
+    memcpy(dst, &h, sizeof(h));
+    if (n1)
+        memcpy(dst + sizeof(h), p1, n1);
+    if (n2)
+        memcpy(dst + sizeof(h) + n1, p2, n2);
+    memset(dst + sizeof(h) + n1 + n2, 0, align8(n1 + n2) - n1 - n2);
+    if (!nRecords || h.mono - lastIdxMono >= idxPeriod)
+    {
+        const uint64_t entry[2] = {h.mono, used};
+        fwrite(entry, sizeof(entry), 1, idx);
+        fflush(idx);
+        lastIdxMono = h.mono;
+    }
+    used += recSize;
+    ++nRecords;
+    pthread_mutex_unlock(&lock);
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+FeedLogReader::FeedLogReader(const std::string &path)
+  : map(NULL)
+  , size(0)
+  , pos(sizeof(FeedLog::FileHeader))
+  , first(0)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error(sysError("can't open", path, __LINE__));
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < (off_t)sizeof(FeedLog::FileHeader))
+    {
+        ::close(fd);
+        throw std::runtime_error(sysError("not a feed log", path, __LINE__));
+    }
+    size = st.st_size;
+    void *m = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED)
+        throw std::runtime_error(sysError("can't map", path, __LINE__));
+    map = (const char*)m;
+    madvise(m, size, MADV_SEQUENTIAL);
+
+    FeedLog::FileHeader h;
+    memcpy(&h, map, sizeof(h));
+    if (memcmp(h.magic, feedMagic, sizeof(h.magic)) ||
+        h.version != FeedLog::version || h.headerSize != sizeof(h))
+    {
+        munmap((void*)map, size);
+        errno = EINVAL;
+        throw std::runtime_error(sysError("not a feed log", path, __LINE__));
+    }
+
+    // без индекса seek() просматривает записи с начала
+    FILE *f = fopen((path + ".idx").c_str(), "rb");
+    if (f)
+    {
+        IdxEntry e;
+        while (fread(&e, sizeof(e), 1, f) == 1)
+            if (e.offset < size)
+                index.push_back(e);
+        fclose(f);
+    }
+
+    const FeedLog::RecHeader *rh;
+    const void *data;
+    if (next(rh, data))
+        first = rh->mono;
+    rewind();
+}
+
+FeedLogReader::~FeedLogReader()
+{
+    if (map)
+        munmap((void*)map, size);
+}
+
+bool FeedLogReader::next(const FeedLog::RecHeader *&h, const void *&data)
+{
+    if (pos + sizeof(FeedLog::RecHeader) > size)
+        return false;
+    h = (const FeedLog::RecHeader*)(map + pos);
+    // нули - неиспользованный хвост файла после аварийного завершения
+    const size_t recSize = sizeof(*h) + FeedLog::align8(h->size);
+    if (!h->type || pos + recSize > size)
+        return false;
+    data = map + pos + sizeof(*h);
+    pos += recSize;
+    return true;
+}
+
+void FeedLogReader::seek(uint64_t t)
+{
+    rewind();
+    // последняя точка индекса не позже t
+    int lo = 0, hi = (int)index.size();
+    while (lo < hi)
+    {
+        const int mid = (lo + hi) / 2;
+        if (index[mid].mono <= t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo > 0)
+        pos = index[lo - 1].offset;
+    const FeedLog::RecHeader *h;
+    const void *data;
+    size_t prev = pos;
+    while (next(h, data) && h->mono < t)
+        prev = pos;
+    pos = prev;
+}
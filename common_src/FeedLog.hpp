@@ -0,0 +1,146 @@
+#ifndef _FEEDLOG_HPP_
+#define _FEEDLOG_HPP_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/*! \class FeedLog
+ *  \brief Append-only binary log of the data consumed by SatTrajMgr.
+ *
+ *  The file is a header followed by records: RecHeader and a payload
+ *  padded to 8 bytes. It is written through a growing shared mapping, so
+ *  a record costs one memcpy under a mutex; writers are the DB thread,
+ *  the shm thread and the main thread. Every second of monotonic time
+ *  the pair (mono, offset) is appended to the sidecar file path + ".idx",
+ *  which lets FeedLogReader start from any moment without reading the
+ *  log from the beginning. The constructor throws std::runtime_error if
+ *  the files cannot be created; if the log cannot grow later, it reports
+ *  to stderr once and ignores further writes.
+ */
+class FeedLog
+{
+    FeedLog(const FeedLog&);
+    const FeedLog& operator=(const FeedLog&);
+
+public:
+    enum RecType
+    {
+        DbRows = 1,     // channel - тип траектории, DbWindow + DbRow[]
+        GoodRows,       // GoodRow[] из InterCnTrack
+        ShmBatch,       // channel - тип траектории, записи shm как есть
+        Status          // StatusRec
+    };
+
+    struct FileHeader
+    {
+        char magic[8];      // "SATFEED"
+        uint32_t version;
+        uint32_t headerSize;
+    };
+
+    struct RecHeader
+    {
+        uint32_t type;
+        uint32_t channel;
+        uint64_t mono;      // монотонное время записи [нс]
+        uint64_t stel;      // время Stellarium, NTP
+        uint32_t size;      // размер данных без выравнивания
+        uint32_t reserved;
+    };
+
+    //! окно, по которому обрезана траектория перед добавлением строк
+    struct DbWindow
+    {
+        uint64_t lTime, rTime;
+    };
+
+    struct DbRow
+    {
+        uint64_t time;
+        double az, el, dist;
+        int32_t id;
+        int32_t prepend;
+    };
+
+    struct GoodRow
+    {
+        uint64_t time;
+        double az, el, dist;
+    };
+
+    struct StatusRec
+    {
+        int32_t dbUp;
+        int32_t adjValid;
+        int32_t azAdj, zaAdj;
+    };
+
+    static const uint32_t version = 1;
+
+    //! creates (truncates) path and path + ".idx"
+    explicit FeedLog(const std::string &path);
+    ~FeedLog();
+
+    //! payload of two parts to avoid assembling records
+    bool write(RecType type, uint32_t channel, uint64_t stel,
+               const void *p1, size_t n1, const void *p2 = 0, size_t n2 = 0);
+    uint64_t bytes(void) const {return used;}
+    unsigned long long records(void) const {return nRecords;}
+
+    static uint64_t monoNs(void);
+    static size_t align8(size_t n) {return (n + 7) & ~(size_t)7;}
+
+private:
+    std::string path;
+    int fd;
+    FILE *idx;
+    char *map;
+    uint64_t cap, used;
+    uint64_t lastIdxMono;
+    unsigned long long nRecords;
+    bool failed;
+    pthread_mutex_t lock;
+
+    bool grow(uint64_t need);
+    void close(void);
+};
+
+/*! \class FeedLogReader
+ *  \brief Sequential reader of a FeedLog file mapped read-only.
+ */
+class FeedLogReader
+{
+    FeedLogReader(const FeedLogReader&);
+    const FeedLogReader& operator=(const FeedLogReader&);
+
+public:
+    //! throws std::runtime_error if the file is not a FeedLog
+    explicit FeedLogReader(const std::string &path);
+    ~FeedLogReader();
+
+    /*! Next record, false at the end of the log or at a truncated
+     *  record (the writer was killed).
+     */
+    bool next(const FeedLog::RecHeader *&h, const void *&data);
+    //! position before the first record with mono >= t, uses the .idx
+    void seek(uint64_t t);
+    void rewind(void) {pos = sizeof(FeedLog::FileHeader);}
+    uint64_t firstMono(void) const {return first;}
+
+private:
+    struct IdxEntry
+    {
+        uint64_t mono, offset;
+    };
+
+    const char *map;
+    size_t size, pos;
+    uint64_t first;
+    std::vector<IdxEntry> index;
+};
+
+#endif // _FEEDLOG_HPP_
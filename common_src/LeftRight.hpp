@@ -0,0 +1,125 @@
+#ifndef _LEFTRIGHT_HPP_
+#define _LEFTRIGHT_HPP_
+
+#include <QtCore/QAtomicInt>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+/*! \class LeftRight
+ *  \brief Two instances of T with wait-free readers (Left-Right pattern).
+ *
+ *  Readers pin the published instance with Reader and never block or
+ *  spin. A writer changes the standby instance, publishes it with an
+ *  atomic switch, waits until the readers leave the other instance and
+ *  repeats the change there, so both instances stay equal between
+ *  writes. Writers are serialized by a mutex.
+ *
+ *  Writer sequence:
+ *  \code
+ *  T &b = lr.beginWrite();     // standby instance
+ *  change(b);
+ *  T &o = lr.publish();        // b is visible to readers, o is free
+ *  change(o);                  // or o = b
+ *  lr.endWrite();
+ *  \endcode
+ */
+template <class T>
+class LeftRight
+{
+    LeftRight(const LeftRight&);
+    const LeftRight& operator=(const LeftRight&);
+
+public:
+    class Reader
+    {
+        Reader(const Reader&);
+        const Reader& operator=(const Reader&);
+
+    public:
+        explicit Reader(LeftRight &lr)
+          : owner(&lr)
+          , version(lr.arrive())
+          , inst(&lr.inst[(int)lr.leftRight])
+        {}
+        ~Reader() {release();}
+
+        const T& get(void) const {return *inst;}
+        //! unpin before the end of scope
+        void release(void)
+        {
+            if (owner)
+                owner->depart(version);
+            owner = 0;
+        }
+
+    private:
+        LeftRight *owner;
+        int version;
+        const T *inst;
+    };
+
+    LeftRight()
+      : leftRight(0)
+      , versionIndex(0)
+      , waitedNs(0)
+    {
+        pthread_mutex_init(&writeLock, NULL);
+    }
+    ~LeftRight() {pthread_mutex_destroy(&writeLock);}
+
+    T& beginWrite(void)
+    {
+        pthread_mutex_lock(&writeLock);
+        return inst[1 - (int)leftRight];
+    }
+
+    T& publish(void)
+    {
+        const int lr = (int)leftRight;
+        leftRight.fetchAndStoreOrdered(1 - lr);
+        const int prev = (int)versionIndex;
+        waitReaders(1 - prev);
+        versionIndex.fetchAndStoreOrdered(1 - prev);
+        waitReaders(prev);
+        return inst[lr];
+    }
+
+    void endWrite(void) {pthread_mutex_unlock(&writeLock);}
+
+    //! published instance; without Reader only for the writer
+    const T& published(void) const {return inst[(int)leftRight];}
+    //! total time publish() waited for readers, ns; only for the writer
+    unsigned long long waitNs(void) const {return waitedNs;}
+
+private:
+    T inst[2];
+    QAtomicInt leftRight;       // instance for new readers
+    QAtomicInt versionIndex;    // counter for new readers
+    QAtomicInt readers[2];
+    pthread_mutex_t writeLock;
+    unsigned long long waitedNs;    // под writeLock
+
+    int arrive(void)
+    {
+        const int v = (int)versionIndex;
+        readers[v].fetchAndAddOrdered(1);
+        return v;
+    }
+    void depart(int v) {readers[v].fetchAndAddOrdered(-1);}
+    void waitReaders(int v)
+    {
+        if (!(int)readers[v])
+            return;
+        // время меряется только при ожидании, быстрый путь без вызовов
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        while ((int)readers[v])
+            sched_yield();
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        waitedNs += (t1.tv_sec - t0.tv_sec)*1000000000ULL +
+                    t1.tv_nsec - t0.tv_nsec;
+    }
+};
+
+#endif // _LEFTRIGHT_HPP_
@@ -0,0 +1,25 @@
+#include "MeasPointBatch.hpp"
+
+void MeasPointBatch::build(const TrajBuffer &traj, const xNtpTime &stelT,
+                           double fadeWindow, const Vec3f &rgb)
+{
+    verts.clear();
+    cols.clear();
+    if (traj.isEmpty() || fadeWindow <= 0.)
+        return;
+
+    int from, to;
+    traj.window(stelT - xNtpTime(fadeWindow), stelT, from, to);
+    verts.reserve(to - from);
+    cols.reserve(to - from);
+    const double t0 = stelT.doub();
+    for (int i = from; i < to; ++i)
+    {
+        const float tdiff = (t0 - traj.time(i).doub()) / fadeWindow;
+        if (tdiff < 0.f || tdiff >= 1.f)
+            continue;
+        const float alpha = (tdiff > 0.2f)? (1.f - tdiff)/0.8f: 1.f;
+        verts.push_back(traj.vec(i));
+        cols.push_back(Vec4f(rgb[0], rgb[1], rgb[2], alpha));
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef _MEASPOINTBATCH_HPP_
+#define _MEASPOINTBATCH_HPP_
+
+#include "TrajBuffer.hpp"
+
+/*! \class MeasPointBatch
+ *  \brief Vertex and colour arrays for drawing measurements in one call.
+ *
+ *  Selects points younger than the fade window and assigns each of them
+ *  an alpha depending on its age: full brightness for the first 20% of
+ *  the window, then linear fading to zero.
+ */
+class MeasPointBatch
+{
+public:
+    MeasPointBatch() {}
+
+    void build(const TrajBuffer &traj, const xNtpTime &stelT,
+               double fadeWindow, const Vec3f &rgb);
+    const Vec3d* vertices(void) const {return verts.empty()? 0: &verts[0];}
+    const Vec4f* colors(void) const {return cols.empty()? 0: &cols[0];}
+    int size(void) const {return (int)verts.size();}
+    bool isEmpty(void) const {return verts.empty();}
+
+private:
+    std::vector<Vec3d> verts;
+    std::vector<Vec4f> cols;
+};
+
+#endif // _MEASPOINTBATCH_HPP_
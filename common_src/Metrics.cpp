@@ -0,0 +1,337 @@
+#include "Metrics.hpp"
+#include <ntptime/ntptime.h>
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+Metrics::Counter::Counter(double s)
+  : val(0)
+  , scale(s)
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+Metrics::Counter::~Counter()
+{
+    pthread_mutex_destroy(&lock);
+}
+
+void Metrics::Counter::add(unsigned long long n)
+{
+    pthread_mutex_lock(&lock);
+    val += n;
+    pthread_mutex_unlock(&lock);
+}
+
+unsigned long long Metrics::Counter::value(void) const
+{
+    pthread_mutex_lock(&lock);
+    const unsigned long long ret = val;
+    pthread_mutex_unlock(&lock);
+    return ret;
+}
+
+Metrics::Gauge::Gauge()
+  : val(0.)
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+Metrics::Gauge::~Gauge()
+{
+    pthread_mutex_destroy(&lock);
+}
+
+void Metrics::Gauge::set(double v)
+{
+    pthread_mutex_lock(&lock);
+    val = v;
+    pthread_mutex_unlock(&lock);
+}
+
+double Metrics::Gauge::value(void) const
+{
+    pthread_mutex_lock(&lock);
+    const double ret = val;
+    pthread_mutex_unlock(&lock);
+    return ret;
+}
+
+Metrics::Histogram::Histogram(double first, double factor, int n)
+  : counts(n + 1, 0)
+  , count(0)
+  , sum(0.)
+{
+    pthread_mutex_init(&lock, NULL);
+    double b = first;
+    for (int i = 0; i < n; ++i, b *= factor)
+        bounds.push_back(b);
+}
+
+Metrics::Histogram::~Histogram()
+{
+    pthread_mutex_destroy(&lock);
+}
+
+void Metrics::Histogram::observe(double v)
+{
+    // корзин немного, линейный поиск быстрее выделения под бинарный
+    size_t i = 0;
+    while (i < bounds.size() && v > bounds[i])
+        ++i;
+    pthread_mutex_lock(&lock);
+    ++counts[i];
+    ++count;
+    sum += v;
+    pthread_mutex_unlock(&lock);
+}
+
+void Metrics::Histogram::snapshot(Snapshot &s) const
+{
+    pthread_mutex_lock(&lock);
+    s.counts = counts;
+    s.count = count;
+    s.sum = sum;
+    pthread_mutex_unlock(&lock);
+}
+
+double Metrics::Histogram::quantile(const Snapshot &prev, const Snapshot &cur,
+                                    double q) const
+{
+    if (cur.count <= prev.count || cur.counts.size() != counts.size())
+        return 0.;
+    const bool hasPrev = prev.counts.size() == cur.counts.size();
+    const double need = q*(cur.count - prev.count);
+    double acc = 0.;
+    for (size_t i = 0; i < cur.counts.size(); ++i)
+    {
+        const double n = cur.counts[i] - (hasPrev? prev.counts[i]: 0);
+        if (acc + n >= need && n > 0.)
+        {
+            // линейно внутри корзины, за последней границей - граница
+            if (i == bounds.size())
+                return bounds.empty()? 0.: bounds.back();
+            const double lo = i? bounds[i - 1]: 0.;
+            return lo + (bounds[i] - lo)*(need - acc)/n;
+        }
+        acc += n;
+    }
+    return bounds.empty()? 0.: bounds.back();
+}
+
+double Metrics::Histogram::mean(const Snapshot &prev, const Snapshot &cur)
+{
+    if (cur.count <= prev.count)
+        return 0.;
+    return (cur.sum - prev.sum)/(cur.count - prev.count);
+}
+
+Metrics::Metrics()
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+Metrics::~Metrics()
+{
+    for (size_t i = 0; i < families.size(); ++i)
+    {
+        Family *f = families[i];
+        for (size_t j = 0; j < f->entries.size(); ++j)
+        {
+            void *m = f->entries[j].metric;
+            switch (f->kind)
+            {
+                case KCounter:
+                    delete (Counter*)m;
+                    break;
+                case KGauge:
+                    delete (Gauge*)m;
+                    break;
+                case KHistogram:
+                    delete (Histogram*)m;
+                    break;
+            }
+        }
+        delete f;
+    }
+    pthread_mutex_destroy(&lock);
+}
+
+Metrics::Family& Metrics::family(const std::string &name,
+                                 const std::string &help, Kind k)
+{
+    for (size_t i = 0; i < families.size(); ++i)
+        if (families[i]->name == name)
+            return *families[i];
+    Family *f = new Family;
+    f->name = name;
+    f->help = help;
+    f->kind = k;
+    families.push_back(f);
+    return *f;
+}
+
+void* Metrics::find(const Family &f, const std::string &labels)
+{
+    for (size_t i = 0; i < f.entries.size(); ++i)
+        if (f.entries[i].labels == labels)
+            return f.entries[i].metric;
+    return NULL;
+}
+
+Metrics::Counter& Metrics::counter(const std::string &name,
+                                   const std::string &help,
+                                   const std::string &labels, double scale)
+{
+    pthread_mutex_lock(&lock);
+    Family &f = family(name, help, KCounter);
+    Counter *c = (Counter*)find(f, labels);
+    if (!c)
+    {
+        Entry e;
+        e.labels = labels;
+        e.metric = c = new Counter(scale);
+        f.entries.push_back(e);
+    }
+    pthread_mutex_unlock(&lock);
+    return *c;
+}
+
+Metrics::Gauge& Metrics::gauge(const std::string &name,
+                               const std::string &help,
+                               const std::string &labels)
+{
+    pthread_mutex_lock(&lock);
+    Family &f = family(name, help, KGauge);
+    Gauge *g = (Gauge*)find(f, labels);
+    if (!g)
+    {
+        Entry e;
+        e.labels = labels;
+        e.metric = g = new Gauge;
+        f.entries.push_back(e);
+    }
+    pthread_mutex_unlock(&lock);
+    return *g;
+}
+
+Metrics::Histogram& Metrics::histogram(const std::string &name,
+                                       const std::string &help,
+                                       const std::string &labels,
+                                       double first, double factor, int n)
+{
+    pthread_mutex_lock(&lock);
+    Family &f = family(name, help, KHistogram);
+    Histogram *h = (Histogram*)find(f, labels);
+    if (!h)
+    {
+        Entry e;
+        e.labels = labels;
+        e.metric = h = new Histogram(first, factor, n);
+        f.entries.push_back(e);
+    }
+    pthread_mutex_unlock(&lock);
+    return *h;
+}
+
+// {labels} или {labels,extra}, пусто без меток
+static std::string labelSet(const std::string &labels,
+                            const std::string &extra = std::string())
+{
+    if (labels.empty() && extra.empty())
+        return std::string();
+    if (labels.empty() || extra.empty())
+        return "{" + labels + extra + "}";
+    return "{" + labels + "," + extra + "}";
+}
+
+static void appendf(std::string &out, const char *fmt, double v)
+{
+    char buf[64];
+    snprintf(buf, sizeof buf, fmt, v);
+    out += buf;
+}
+
+void Metrics::write(std::string &out) const
+{
+    static const char *const kindName[] = {"counter", "gauge", "histogram"};
+    Histogram::Snapshot s;
+
+    pthread_mutex_lock(&lock);
+    for (size_t i = 0; i < families.size(); ++i)
+    {
+        const Family &f = *families[i];
+        out += "# HELP " + f.name + " " + f.help + "\n";
+        out += "# TYPE " + f.name + " " + kindName[f.kind] + "\n";
+        for (size_t j = 0; j < f.entries.size(); ++j)
+        {
+            const Entry &e = f.entries[j];
+            if (f.kind == KCounter)
+            {
+                const Counter *c = (const Counter*)e.metric;
+                out += f.name + labelSet(e.labels);
+                appendf(out, " %.9g\n", c->value()*c->scale);
+            }
+            else if (f.kind == KGauge)
+            {
+                out += f.name + labelSet(e.labels);
+                appendf(out, " %.9g\n", ((const Gauge*)e.metric)->value());
+            }
+            else
+            {
+                const Histogram *h = (const Histogram*)e.metric;
+                h->snapshot(s);
+                unsigned long long acc = 0;
+                for (size_t k = 0; k < s.counts.size(); ++k)
+                {
+                    char le[48];
+                    if (k < h->bounds.size())
+                        snprintf(le, sizeof le, "le=\"%g\"", h->bounds[k]);
+                    else
+                        snprintf(le, sizeof le, "le=\"+Inf\"");
+                    acc += s.counts[k];
+                    out += f.name + "_bucket" + labelSet(e.labels, le);
+                    appendf(out, " %.0f\n", (double)acc);
+                }
+                out += f.name + "_sum" + labelSet(e.labels);
+                appendf(out, " %.9g\n", s.sum);
+                out += f.name + "_count" + labelSet(e.labels);
+                appendf(out, " %.0f\n", (double)s.count);
+            }
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+bool Metrics::writeFile(const std::string &path) const
+{
+    std::string text;
+    write(text);
+    // читатель видит старый или новый файл целиком
+    const std::string tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "w");
+    if (!f)
+        return false;
+    const bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+    if (fclose(f) || !ok)
+    {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+double Metrics::monoTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+double Metrics::ntpTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9 + (double)NTP_UNIX_DELTA;
+}
@@ -0,0 +1,145 @@
+#ifndef _METRICS_HPP_
+#define _METRICS_HPP_
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+/*! \class Metrics
+ *  \brief Registry of performance counters, gauges and histograms.
+ *
+ *  A metric is registered once by name and labels (Prometheus label list
+ *  without braces, e.g. source="MeasTraj") and lives as long as the
+ *  registry, so references to it stay valid. Registering the same name and
+ *  labels again returns the same metric; a name must not be reused for
+ *  another kind. Metrics are updated from any thread under their own
+ *  mutex. write() produces the Prometheus text exposition format,
+ *  writeFile() replaces the file atomically (suitable for the node
+ *  exporter textfile collector).
+ */
+class Metrics
+{
+    Metrics(const Metrics&);
+    const Metrics& operator=(const Metrics&);
+
+public:
+    class Counter
+    {
+        Counter(const Counter&);
+        const Counter& operator=(const Counter&);
+        friend class Metrics;
+
+    public:
+        void add(unsigned long long n = 1);
+        unsigned long long value(void) const;
+
+    private:
+        mutable pthread_mutex_t lock;
+        unsigned long long val;
+        const double scale;     // множитель при выводе (нс -> с и т.п.)
+
+        explicit Counter(double s);
+        ~Counter();
+    };
+
+    class Gauge
+    {
+        Gauge(const Gauge&);
+        const Gauge& operator=(const Gauge&);
+        friend class Metrics;
+
+    public:
+        void set(double v);
+        double value(void) const;
+
+    private:
+        mutable pthread_mutex_t lock;
+        double val;
+
+        Gauge();
+        ~Gauge();
+    };
+
+    //! observations in exponential buckets first*factor^i, i < n, and +Inf
+    class Histogram
+    {
+        Histogram(const Histogram&);
+        const Histogram& operator=(const Histogram&);
+        friend class Metrics;
+
+    public:
+        struct Snapshot
+        {
+            std::vector<unsigned long long> counts;     // по корзинам
+            unsigned long long count;
+            double sum;
+
+            Snapshot(void): count(0), sum(0.) {}
+        };
+
+        void observe(double v);
+        void snapshot(Snapshot &s) const;
+        //! q-quantile of the observations between two snapshots, 0 if none
+        double quantile(const Snapshot &prev, const Snapshot &cur,
+                        double q) const;
+        static double mean(const Snapshot &prev, const Snapshot &cur);
+
+    private:
+        mutable pthread_mutex_t lock;
+        std::vector<double> bounds;
+        std::vector<unsigned long long> counts;
+        unsigned long long count;
+        double sum;
+
+        Histogram(double first, double factor, int n);
+        ~Histogram();
+    };
+
+    Metrics();
+    ~Metrics();
+
+    Counter& counter(const std::string &name, const std::string &help,
+                     const std::string &labels = std::string(),
+                     double scale = 1.);
+    Gauge& gauge(const std::string &name, const std::string &help,
+                 const std::string &labels = std::string());
+    Histogram& histogram(const std::string &name, const std::string &help,
+                         const std::string &labels, double first,
+                         double factor, int n);
+
+    void write(std::string &out) const;
+    //! false on error, errno is set
+    bool writeFile(const std::string &path) const;
+
+    //! monotonic time, s
+    static double monoTime(void);
+    //! current UTC in NTP seconds
+    static double ntpTime(void);
+
+private:
+    enum Kind
+    {
+        KCounter,
+        KGauge,
+        KHistogram
+    };
+    struct Entry
+    {
+        std::string labels;
+        void *metric;
+    };
+    struct Family
+    {
+        std::string name, help;
+        Kind kind;
+        std::vector<Entry> entries;
+    };
+
+    mutable pthread_mutex_t lock;
+    std::vector<Family*> families;
+
+    Family& family(const std::string &name, const std::string &help, Kind k);
+    static void* find(const Family &f, const std::string &labels);
+};
+
+#endif // _METRICS_HPP_
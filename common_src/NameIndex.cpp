@@ -0,0 +1,39 @@
+#include "NameIndex.hpp"
+#include <algorithm>
+
+void NameIndex::clear(void)
+{
+    entries.clear();
+    exact.clear();
+}
+
+void NameIndex::add(const QString &name, int id)
+{
+    Entry e;
+    e.key = fold(name);
+    e.id = id;
+    entries.append(e);
+}
+
+void NameIndex::build(void)
+{
+    std::sort(entries.begin(), entries.end());
+    exact.clear();
+    exact.reserve(entries.size());
+    for (int i = entries.size() - 1; i >= 0; --i)
+        exact.insert(entries[i].key, i);
+}
+
+int NameIndex::lowerBound(const QString &folded) const
+{
+    int lo = 0, hi = entries.size();
+    while (lo < hi)
+    {
+        const int mid = (lo + hi) / 2;
+        if (entries[mid].key < folded)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
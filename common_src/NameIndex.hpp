@@ -0,0 +1,52 @@
+#ifndef _NAMEINDEX_HPP_
+#define _NAMEINDEX_HPP_
+
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+/*! \class NameIndex
+ *  \brief Case-folded sorted index of object names.
+ *
+ *  Names are added with caller-chosen ids and become searchable after
+ *  build(). Keys are folded once (trimmed, upper case), so queries do not
+ *  convert names: prefix completion is a binary search plus a walk over
+ *  the matching keys in sorted order, exact lookup is a hash lookup.
+ *  Equal keys are adjacent and ordered by id.
+ */
+class NameIndex
+{
+public:
+    NameIndex() {}
+
+    static QString fold(const QString &name) {return name.trimmed().toUpper();}
+
+    void clear(void);
+    void add(const QString &name, int id);
+    void build(void);
+
+    int size(void) const {return entries.size();}
+    const QString& key(int i) const {return entries[i].key;}
+    int id(int i) const {return entries[i].id;}
+
+    //! first entry with key >= folded (size() if none)
+    int lowerBound(const QString &folded) const;
+    bool hasPrefix(int i, const QString &folded) const
+        {return i < entries.size() && entries[i].key.startsWith(folded);}
+    //! first entry with key == folded or -1
+    int find(const QString &folded) const {return exact.value(folded, -1);}
+
+private:
+    struct Entry
+    {
+        QString key;
+        int id;
+        bool operator<(const Entry &o) const
+            {return key < o.key || (key == o.key && id < o.id);}
+    };
+
+    QVector<Entry> entries;
+    QHash<QString, int> exact;  // ключ - индекс первой записи
+};
+
+#endif // _NAMEINDEX_HPP_
@@ -0,0 +1,84 @@
+#include "OrbitSampler.hpp"
+#include <stdlib.h>
+
+OrbitSampler::OrbitSampler()
+  : head(0)
+  , filled(false)
+  , t0(0.)
+  , interval(0.)
+  , halfSpan(0.)
+  , curWindow(0)
+  , curSegments(0)
+  , nEval(0)
+{
+}
+
+void OrbitSampler::clear(void)
+{
+    filled = false;
+}
+
+void OrbitSampler::fill(const Model &m, double jd)
+{
+    double evalTime = jd - halfSpan;
+    for (size_t i = 0; i < pts.size(); ++i)
+    {
+        m.orbitPos(evalTime, pts[i]);
+        evalTime += interval;
+    }
+    nEval += pts.size();
+    head = 0;
+    t0 = jd;
+    filled = true;
+}
+
+void OrbitSampler::update(const Model &m, double jd, unsigned window,
+                          unsigned segments)
+{
+    if (!segments)
+        segments = 1;
+    if (!filled || window != curWindow || segments != curSegments)
+    {
+        curWindow = window;
+        curSegments = segments;
+        interval = (double)window / ((double)segments * 24. * 60. * 60.);
+        halfSpan = (double)window / (2. * 24. * 60. * 60.);
+        pts.resize(segments + 1);
+        fill(m, jd);
+        return;
+    }
+
+    // сдвиг окна на целое число интервалов
+    const int n = (int)pts.size();
+    const int slots = (int)((jd - t0) / interval);
+    if (!slots)
+        return;
+    if (abs(slots) > (int)segments)
+    {
+        fill(m, jd);
+        return;
+    }
+    if (slots > 0)
+    {   // точки добавляются в конец на место первых
+        double evalTime = t0 + halfSpan + interval;
+        for (int i = 0; i < slots; ++i)
+        {
+            m.orbitPos(evalTime, pts[head]);
+            head = (head + 1) % n;
+            evalTime += interval;
+        }
+    }
+    else
+    {   // время идёт назад: точки добавляются в начало на место последних
+        double evalTime = t0 - halfSpan - interval;
+        for (int i = 0; i < -slots; ++i)
+        {
+            head = (head + n - 1) % n;
+            m.orbitPos(evalTime, pts[head]);
+            evalTime -= interval;
+        }
+    }
+    nEval += abs(slots);
+    // окно сдвигается ровно на целые интервалы, шаг точек не меняется
+    t0 += slots*interval;
+}
@@ -0,0 +1,54 @@
+#ifndef _ORBITSAMPLER_HPP_
+#define _ORBITSAMPLER_HPP_
+
+#include "VecMath.hpp"
+#include <vector>
+
+/*! \class OrbitSampler
+ *  \brief Orbit line points in a time window centred on the current time.
+ *
+ *  The window of window seconds is split into segments equal intervals,
+ *  the segments + 1 points are evaluated by a Model. When the time moves
+ *  by whole intervals, only the points entering the window are evaluated,
+ *  in place of the points leaving it at the other end (ring buffer, no
+ *  allocation after the first fill). A jump by more than the window or a
+ *  change of the parameters evaluates all points again.
+ */
+class OrbitSampler
+{
+public:
+    class Model
+    {
+    public:
+        virtual ~Model() {}
+
+        //! direction of the object at jd
+        virtual void orbitPos(double jd, Vec3d &out) const =0;
+    };
+
+    OrbitSampler();
+
+    //! jd - current time, window [s]
+    void update(const Model &m, double jd, unsigned window, unsigned segments);
+    void clear(void);
+
+    int size(void) const {return filled? (int)pts.size(): 0;}
+    //! point i, 0 - the earliest
+    const Vec3d& point(int i) const {return pts[(head + i) % pts.size()];}
+    double pointTime(int i) const {return t0 - halfSpan + i*interval;}
+    //! number of Model::orbitPos() calls
+    unsigned long long evaluations(void) const {return nEval;}
+
+private:
+    std::vector<Vec3d> pts;
+    int head;
+    bool filled;
+    double t0;          // момент, относительно которого построено окно (JD)
+    double interval, halfSpan;  // в JD
+    unsigned curWindow, curSegments;
+    unsigned long long nEval;
+
+    void fill(const Model &m, double jd);
+};
+
+#endif // _ORBITSAMPLER_HPP_
@@ -0,0 +1,101 @@
+#include "ResidualEngine.hpp"
+#include "AzElConv.hpp"
+#include <math.h>
+
+void ResidualEngine::Batch::clear(void)
+{
+    time.clear();
+    az.clear();
+    el.clear();
+    dist.clear();
+}
+
+void ResidualEngine::Columns::resize(int n)
+{
+    dAz.resize(n);
+    dEl.resize(n);
+    dDist.resize(n);
+    valid.assign(n, 0);
+}
+
+// разность углов в [-pi, pi]
+static inline double angleDiff(double a, double b)
+{
+    double d = a - b;
+    if (d > M_PI || d < -M_PI)
+        d -= 2*M_PI*floor((d + M_PI)/(2*M_PI));
+    return d;
+}
+
+int ResidualEngine::compute(const TrajBuffer &ref, const Batch &meas,
+                            Columns &out)
+{
+    const int n = meas.size();
+    out.resize(n);
+    refVec.clear();
+    refDist.clear();
+    rows.clear();
+    refVec.reserve(n);
+    refDist.reserve(n);
+    rows.reserve(n);
+    if (ref.size() < 2)
+        return 0;
+
+    // слияние: отрезок опорной траектории сдвигается только вперёд
+    const uint64_t tFirst = ref.timeExt(0), tLast = ref.timeExt(ref.size() - 1);
+    int j = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        const uint64_t t = meas.time[i];
+        if (t < tFirst || t >= tLast)
+            continue;
+        if (t < ref.timeExt(j))
+            j = ref.segment(xNtpTime(t));   // нарушен порядок измерений
+        while (ref.timeExt(j + 1) <= t)
+            ++j;
+        const uint64_t t_down = ref.timeExt(j), t_up = ref.timeExt(j + 1);
+        const double a = (double)(t - t_down)/(double)(t_up - t_down);
+        const double b = (double)(t_up - t)/(double)(t_up - t_down);
+        const Vec3d &v0 = ref.vec(j), &v1 = ref.vec(j + 1);
+        refVec.push_back(Vec3d(v0[0]*b + v1[0]*a, v0[1]*b + v1[1]*a,
+                               v0[2]*b + v1[2]*a));
+        refDist.push_back(ref.dist(j)*b + ref.dist(j + 1)*a);
+        rows.push_back(i);
+    }
+
+    const int m = (int)rows.size();
+    if (!m)
+        return 0;
+    refAz.resize(m);
+    refEl.resize(m);
+    AzElConv::toAzEl(&refVec[0], &refAz[0], &refEl[0], m);
+    const double k = 180.*60./M_PI;
+    for (int r = 0; r < m; ++r)
+    {
+        const int i = rows[r];
+        out.dAz[i] = angleDiff(meas.az[i], refAz[r])*k;
+        out.dEl[i] = (meas.el[i] - refEl[r])*k;
+        out.dDist[i] = meas.dist[i] - refDist[r];
+        out.valid[i] = 1;
+    }
+    return m;
+}
+
+void ResidualEngine::writeCsvHeader(FILE *f)
+{
+    fprintf(f, "time,az_deg,el_deg,dist_m,daz_angmin,del_angmin,ddist_m\n");
+}
+
+void ResidualEngine::writeCsv(FILE *f, const Batch &meas, const Columns &res,
+                              int from)
+{
+    const double k = 180./M_PI;
+    for (int i = from; i < meas.size() && i < res.size(); ++i)
+    {
+        if (!res.valid[i])
+            continue;
+        fprintf(f, "%.6f,%.6f,%.6f,%.1f,%.4f,%.4f,%.1f\n",
+                xNtpTime(meas.time[i]).doub(), meas.az[i]*k, meas.el[i]*k,
+                meas.dist[i], res.dAz[i], res.dEl[i], res.dDist[i]);
+    }
+}
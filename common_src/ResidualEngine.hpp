@@ -0,0 +1,71 @@
+#ifndef _RESIDUALENGINE_HPP_
+#define _RESIDUALENGINE_HPP_
+
+#include "TrajBuffer.hpp"
+#include <stdio.h>
+#include <vector>
+
+/*! \class ResidualEngine
+ *  \brief Residuals of measurements relative to a reference trajectory.
+ *
+ *  A batch of time-sorted measurements is merged with the time-sorted
+ *  reference in one pass: the reference segment only moves forward, and
+ *  the reference point is interpolated in the same way as
+ *  TrajBuffer::interpolate. Reference directions are converted to az/el
+ *  with the AzElConv batch kernel. The result has one row per measurement;
+ *  rows outside the reference are marked invalid.
+ */
+class ResidualEngine
+{
+    ResidualEngine(const ResidualEngine&);
+    const ResidualEngine& operator=(const ResidualEngine&);
+
+public:
+    //! measurements, radar az/el [rad], range [m]
+    struct Batch
+    {
+        std::vector<uint64_t> time;
+        std::vector<double> az, el, dist;
+
+        int size(void) const {return (int)time.size();}
+        bool isEmpty(void) const {return time.empty();}
+        void append(uint64_t t, double a, double e, double d)
+        {
+            time.push_back(t);
+            az.push_back(a);
+            el.push_back(e);
+            dist.push_back(d);
+        }
+        void clear(void);
+    };
+
+    //! residuals measurement - reference, dAz/dEl [ang min], dDist [m]
+    struct Columns
+    {
+        std::vector<double> dAz, dEl, dDist;
+        std::vector<char> valid;
+
+        int size(void) const {return (int)valid.size();}
+        void resize(int n);
+    };
+
+    ResidualEngine() {}
+
+    /*! Residuals of meas relative to ref into out (resized to meas).
+     *  \return number of valid rows
+     */
+    int compute(const TrajBuffer &ref, const Batch &meas, Columns &out);
+
+    static void writeCsvHeader(FILE *f);
+    //! rows [from, meas.size()) with valid residuals
+    static void writeCsv(FILE *f, const Batch &meas, const Columns &res,
+                         int from = 0);
+
+private:
+    // опорные точки для строк с valid
+    std::vector<Vec3d> refVec;
+    std::vector<double> refDist, refAz, refEl;
+    std::vector<int> rows;
+};
+
+#endif // _RESIDUALENGINE_HPP_
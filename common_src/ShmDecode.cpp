@@ -0,0 +1,53 @@
+#include "ShmDecode.hpp"
+#include "AzElConv.hpp"
+#include <inter_cn/structs.h>
+#include <coord_conv/CoordConv.h>
+#include <algorithm>
+
+void ShmDecode::measSamples(const void *data, const TrajBuffer::Span &out)
+{
+    const NeOdnDetectionSampleType *in = (const NeOdnDetectionSampleType*)data;
+    const int chunk = 256;
+    double az[chunk], el[chunk];
+    for (int i0 = 0; i0 < out.size; i0 += chunk)
+    {
+        const int n = std::min(chunk, out.size - i0);
+        for (int i = 0; i < n; ++i)
+        {
+            const NeOdnDetectionSampleType &smp = in[i0 + i];
+            xNtpTime t;
+            t = smp.time;
+            out.time[i0 + i] = t.ext();
+            out.dist[i0 + i] = smp.D;
+            az[i] = smp.Az;
+            el[i] = smp.El;
+        }
+        AzElConv::toVec(az, el, out.vec + i0, n);
+    }
+}
+
+void ShmDecode::antPackets(const void *data, const TrajBuffer::Span &out)
+{
+    const adrive_ext_pac_t *in = (const adrive_ext_pac_t*)data;
+    const int chunk = 256;
+    double az[chunk], el[chunk];
+    for (int i0 = 0; i0 < out.size; i0 += chunk)
+    {
+        const int n = std::min(chunk, out.size - i0);
+        for (int i = 0; i < n; ++i)
+        {
+            const adrive_ext_pac_t &pac = in[i0 + i];
+            xNtpTime t;
+            t = pac.ts;
+            out.time[i0 + i] = t.ext();
+            out.dist[i0 + i] = 0.;
+            int_point ant_point;
+            ant_point.first = *(const s32*)(&pac.Az);
+            ant_point.second = *(const s32*)(&pac.El);
+            double_point rls_point = antenna2radar(ant_point);
+            az[i] = rls_point.first;
+            el[i] = rls_point.second;
+        }
+        AzElConv::toVec(az, el, out.vec + i0, n);
+    }
+}
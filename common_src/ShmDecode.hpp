@@ -0,0 +1,21 @@
+#ifndef _SHMDECODE_HPP_
+#define _SHMDECODE_HPP_
+
+#include "TrajBuffer.hpp"
+
+/*! \class ShmDecode
+ *  \brief Batch decoding of shared memory records into trajectory storage.
+ *
+ *  The functions are TrajStore::Decoder: in holds out.size records, the
+ *  directions are converted by AzElConv in chunks.
+ */
+class ShmDecode
+{
+public:
+    // отметки измерений NeOdnDetectionSampleType
+    static void measSamples(const void *in, const TrajBuffer::Span &out);
+    // положения антенны adrive_ext_pac_t
+    static void antPackets(const void *in, const TrajBuffer::Span &out);
+};
+
+#endif // _SHMDECODE_HPP_
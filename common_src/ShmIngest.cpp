@@ -0,0 +1,233 @@
+#include "ShmIngest.hpp"
+#include "Trace.hpp"
+
+#include <QtCore/QDebug>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+ShmIngest::Stats::Stats(void)
+  : open(false)
+  , failed(false)
+  , reads(0)
+  , records(0)
+  , idle(0)
+  , errors(0)
+  , maxBatch(0)
+{
+}
+
+ShmIngest::ShmIngest(void)
+  : busy(NULL)
+  , next(0)
+  , thread(0)
+  , stopReq(false)
+{
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cv, NULL);
+}
+
+ShmIngest::~ShmIngest()
+{
+    stop();
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i]->st.open)
+            shm_sbuf_deinit(&entries[i]->cont);
+        delete entries[i];
+    }
+    pthread_cond_destroy(&cv);
+    pthread_mutex_destroy(&lock);
+}
+
+bool ShmIngest::start(void)
+{
+    if (thread)
+        return true;
+    stopReq = false;
+    if (pthread_create(&thread, NULL, callRoutine, this))
+    {
+        qWarning() << "ShmIngest pthread_create() " << strerror(errno);
+        thread = 0;
+        return false;
+    }
+    return true;
+}
+
+void ShmIngest::stop(void)
+{
+    if (!thread)
+        return;
+    pthread_mutex_lock(&lock);
+    stopReq = true;
+    pthread_cond_broadcast(&cv);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+    thread = 0;
+}
+
+void ShmIngest::attach(Source *src)
+{
+    Entry *e = new Entry;
+    e->src = src;
+    memset(&e->cont, 0, sizeof e->cont);
+    e->scratch.resize(src->shmCapacity() * src->shmRecordSize());
+
+    pthread_mutex_lock(&lock);
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i]->src == src)
+        {
+            pthread_mutex_unlock(&lock);
+            delete e;
+            return;
+        }
+    }
+    entries.push_back(e);
+    pthread_cond_broadcast(&cv);
+    pthread_mutex_unlock(&lock);
+}
+
+void ShmIngest::detach(Source *src)
+{
+    Entry *e = NULL;
+    pthread_mutex_lock(&lock);
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i]->src == src)
+        {
+            e = entries[i];
+            while (busy == e)
+                pthread_cond_wait(&cv, &lock);
+            entries.erase(entries.begin() + i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    if (!e)
+        return;
+    if (e->st.open)
+        shm_sbuf_deinit(&e->cont);
+    delete e;
+}
+
+bool ShmIngest::stats(const Source *src, Stats &st) const
+{
+    bool found = false;
+    pthread_mutex_lock(&lock);
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i]->src == src)
+        {
+            st = entries[i]->st;
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return found;
+}
+
+void* ShmIngest::routine(void)
+{
+    SATTRAJ_TRACE_THREAD("shm");
+    pthread_mutex_lock(&lock);
+    while (!stopReq)
+    {
+        int active = 0;
+        for (size_t i = 0; i < entries.size(); ++i)
+            active += !entries[i]->st.failed;
+        if (!active)
+        {
+            pthread_cond_wait(&cv, &lock);
+            continue;
+        }
+        if (next >= entries.size())
+            next = 0;
+        Entry *e = entries[next++];
+        if (e->st.failed)
+            continue;
+
+        // чтение без блокировки, detach() ждёт его окончания
+        busy = e;
+        pthread_mutex_unlock(&lock);
+        Stats d;
+        if (!e->st.open)
+            open(*e, d);
+        else
+            read(*e, sliceNsec / active, d);
+        pthread_mutex_lock(&lock);
+        busy = NULL;
+
+        e->st.open = e->st.open || d.open;
+        e->st.failed = d.failed;
+        e->st.reads += d.reads;
+        e->st.records += d.records;
+        e->st.idle += d.idle;
+        e->st.errors += d.errors;
+        if (d.maxBatch > e->st.maxBatch)
+            e->st.maxBatch = d.maxBatch;
+        pthread_cond_broadcast(&cv);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+void ShmIngest::open(Entry &e, Stats &d)
+{
+    SATTRAJ_TRACE_SCOPE("ShmIngest::open");
+    const char *name = e.src->shmName();
+    int err = e.src->shmOpen(e.cont);
+    if (err < 0)
+    {
+        qWarning() << name << "Shm buffer init failed with " << err << " - " <<
+                      shm_sbuf_error(err);
+        if ((err == (int)SHM_ERR) || (err == (int)SEM_ERR))
+        {
+            qWarning() << "msg from shmsbuf - " << e.cont.err_msg;
+        }
+    }
+    else if (err != (int)CONN_TO_EXISTING)
+    {
+        qWarning() << name << "Shm buffer init success with " << err << ", " <<
+                      (int)CONN_TO_EXISTING << " expected";
+    }
+    else
+    {
+        d.open = true;
+        return;
+    }
+    shm_sbuf_deinit(&e.cont);
+    d.failed = true;
+    ++d.errors;
+    e.src->shmFailed();
+}
+
+void ShmIngest::read(Entry &e, long nsec, Stats &d)
+{
+    SATTRAJ_TRACE_SCOPE("ShmIngest::read");
+    timespec to = {0, nsec};
+    int n = shm_sbuf_nread(&e.cont, &e.scratch[0], &to);
+    if (n > 0)
+    {
+        ++d.reads;
+        d.records += n;
+        d.maxBatch = n;
+        e.src->shmConsume(&e.scratch[0], n);
+    }
+    else if ((n == (int)SHM_ERR) || (n == (int)SEM_ERR))
+    {
+        ++d.errors;
+        qWarning() << e.src->shmName() << "shm_sbuf_nread() returned " << n;
+        qWarning() << "msg from shmsbuf - " << e.cont.err_msg;
+        // ошибка не должна превращать опрос в холостой цикл
+        nanosleep(&to, NULL);
+        e.src->shmIdle();
+    }
+    else
+    {
+        // новых записей нет, но окно по времени сдвигается
+        ++d.idle;
+        e.src->shmIdle();
+    }
+}
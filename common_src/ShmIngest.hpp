@@ -0,0 +1,94 @@
+#ifndef _SHMINGEST_HPP_
+#define _SHMINGEST_HPP_
+
+#include <shmci/shmsbuf.h>
+#include <pthread.h>
+#include <vector>
+
+/*! \class ShmIngest
+ *  \brief One thread reading all shared memory buffers (shmsbuf) of the plugin.
+ *
+ *  Sources are attached with attach() and polled in turn by a single
+ *  worker thread. shmsbuf offers only a blocking read with a timeout, so
+ *  every source is read with a short time slice and the whole round takes
+ *  at most sliceNsec. The worker checks the stop request between slices,
+ *  stop() and detach() never cancel the thread. Read records are passed to
+ *  Source::shmConsume() in the worker thread.
+ */
+class ShmIngest
+{
+    ShmIngest(const ShmIngest&);
+    const ShmIngest& operator=(const ShmIngest&);
+
+public:
+    class Source
+    {
+    public:
+        virtual ~Source() {}
+
+        //! name for messages
+        virtual const char* shmName(void) const =0;
+        //! connect cont to the buffer, returns shm_sbuf_init() result
+        virtual int shmOpen(ShmSBuf &cont) =0;
+        //! size of one record and capacity of the buffer in records
+        virtual int shmRecordSize(void) const =0;
+        virtual int shmCapacity(void) const =0;
+        //! n records have been read into data
+        virtual void shmConsume(const void *data, int n) =0;
+        //! no new records during the time slice
+        virtual void shmIdle(void) {}
+        //! the buffer can't be opened, the source is not polled any more
+        virtual void shmFailed(void) {}
+    };
+
+    struct Stats
+    {
+        Stats(void);
+
+        bool open;
+        bool failed;
+        unsigned long long reads;    // чтения с записями
+        unsigned long long records;  // прочитано записей
+        unsigned long long idle;     // чтения без записей
+        unsigned long long errors;   // ошибки shmsbuf
+        int maxBatch;                // наибольшая порция записей
+    };
+
+    ShmIngest(void);
+    ~ShmIngest();
+
+    bool start(void);
+    void stop(void);
+    void attach(Source *src);
+    //! returns when the worker does not use src any more
+    void detach(Source *src);
+    //! false if src is not attached
+    bool stats(const Source *src, Stats &st) const;
+
+private:
+    struct Entry
+    {
+        Source *src;
+        ShmSBuf cont;
+        std::vector<char> scratch;  // буфер чтения, выделяется один раз
+        Stats st;
+    };
+
+    std::vector<Entry*> entries;
+    Entry *busy;        // источник, читаемый потоком без блокировки
+    size_t next;
+    pthread_t thread;
+    mutable pthread_mutex_t lock;
+    pthread_cond_t cv;
+    bool stopReq;
+
+    static const long sliceNsec = 50000000; // цикл опроса всех источников
+
+    void* routine(void);
+    void open(Entry &e, Stats &d);
+    void read(Entry &e, long nsec, Stats &d);
+
+    static void* callRoutine(void *arg) {return ((ShmIngest*)arg)->routine();}
+};
+
+#endif // _SHMINGEST_HPP_
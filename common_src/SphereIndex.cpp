@@ -0,0 +1,127 @@
+#include "SphereIndex.hpp"
+#include <algorithm>
+#include <math.h>
+
+SphereIndex::SphereIndex(double cellDeg)
+  : count(0)
+{
+    const int nRings = std::max(2, (int)ceil(180. / std::max(cellDeg, 0.1)));
+    ringHeight = M_PI / nRings;
+    ringFirst.resize(nRings + 1);
+    ringFirst[0] = 0;
+    for (int r = 0; r < nRings; ++r)
+    {
+        // ширина ячейки по широте середины кольца близка к высоте кольца
+        const double dec = -M_PI_2 + (r + 0.5)*ringHeight;
+        const int n = std::max(1, (int)ceil(2*M_PI*cos(dec) / ringHeight));
+        ringFirst[r + 1] = ringFirst[r] + n;
+    }
+    cells.resize(ringFirst[nRings]);
+}
+
+int SphereIndex::ringOf(double dec) const
+{
+    const int r = (int)floor((dec + M_PI_2) / ringHeight);
+    return std::min(rings() - 1, std::max(0, r));
+}
+
+int SphereIndex::cellOf(const Vec3d &v) const
+{
+    const double dec = atan2(v[2], sqrt(v[0]*v[0] + v[1]*v[1]));
+    double lon = atan2(v[1], v[0]);
+    if (lon < 0.)
+        lon += 2*M_PI;
+    const int r = ringOf(dec);
+    const int n = ringCells(r);
+    return ringFirst[r] + std::min(n - 1, (int)(lon / (2*M_PI) * n));
+}
+
+void SphereIndex::update(int id, const Vec3d &pos)
+{
+    if (id < 0)
+        return;
+    if (id >= (int)items.size())
+        items.resize(id + 1);
+    Item &it = items[id];
+    it.pos = pos;
+    it.pos.normalize();
+    const int c = cellOf(it.pos);
+    if (c == it.cell)
+        return;
+    if (it.cell >= 0)
+        remove(id);
+    it.cell = c;
+    it.slot = (int)cells[c].size();
+    cells[c].push_back(id);
+    ++count;
+}
+
+void SphereIndex::remove(int id)
+{
+    if (!contains(id))
+        return;
+    Item &it = items[id];
+    // на место удаляемой точки ставится последняя точка ячейки
+    std::vector<int> &cell = cells[it.cell];
+    const int last = cell.back();
+    cell[it.slot] = last;
+    items[last].slot = it.slot;
+    cell.pop_back();
+    it.cell = -1;
+    --count;
+}
+
+void SphereIndex::clear(void)
+{
+    for (size_t c = 0; c < cells.size(); ++c)
+        cells[c].clear();
+    items.clear();
+    count = 0;
+}
+
+void SphereIndex::scanCell(int c, const Vec3d &v, double cosLim,
+                           std::vector<int> &out) const
+{
+    const std::vector<int> &cell = cells[c];
+    for (size_t i = 0; i < cell.size(); ++i)
+    {
+        if (items[cell[i]].pos.dot(v) >= cosLim)
+            out.push_back(cell[i]);
+    }
+}
+
+void SphereIndex::query(const Vec3d &av, double cosLim,
+                        std::vector<int> &out) const
+{
+    if (!count)
+        return;
+    Vec3d v(av);
+    v.normalize();
+    const double rad = acos(std::min(1., std::max(-1., cosLim)));
+    const double dec = atan2(v[2], sqrt(v[0]*v[0] + v[1]*v[1]));
+    const double decLo = dec - rad, decHi = dec + rad;
+    const int r0 = ringOf(decLo), r1 = ringOf(decHi);
+
+    // конус с полюсом или больше полусферы - кольца целиком
+    double dLon = M_PI;
+    if (decHi < M_PI_2 && decLo > -M_PI_2 && rad < M_PI_2)
+        dLon = asin(std::min(1., sin(rad) / cos(dec)));
+    double lon = atan2(v[1], v[0]);
+    if (lon < 0.)
+        lon += 2*M_PI;
+
+    for (int r = r0; r <= r1; ++r)
+    {
+        const int n = ringCells(r);
+        const int c0 = (int)floor((lon - dLon) / (2*M_PI) * n);
+        const int c1 = (int)floor((lon + dLon) / (2*M_PI) * n);
+        if (dLon >= M_PI || c1 - c0 + 1 >= n)
+        {
+            for (int c = 0; c < n; ++c)
+                scanCell(ringFirst[r] + c, v, cosLim, out);
+            continue;
+        }
+        for (int c = c0; c <= c1; ++c)
+            scanCell(ringFirst[r] + (c + n) % n, v, cosLim, out);
+    }
+}
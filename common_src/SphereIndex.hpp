@@ -0,0 +1,61 @@
+#ifndef _SPHEREINDEX_HPP_
+#define _SPHEREINDEX_HPP_
+
+#include "VecMath.hpp"
+#include <vector>
+
+/*! \class SphereIndex
+ *  \brief Grid of the unit sphere for cone queries over moving points.
+ *
+ *  The sphere is split into iso-latitude rings of equal height, each
+ *  ring into cells of about the same width, so the cells have nearly
+ *  equal area. A point is identified by a small non-negative id chosen
+ *  by the caller; update() moves it to another cell only if its cell has
+ *  changed, so positions can be refreshed every frame. A cone query
+ *  visits only the cells overlapping the cone and checks the stored
+ *  directions exactly. The frame of the directions does not matter as
+ *  long as queries use the same frame.
+ */
+class SphereIndex
+{
+public:
+    //! cellDeg - approximate cell size [deg]
+    explicit SphereIndex(double cellDeg = 2.);
+
+    //! insert or move the point id, pos need not be normalized
+    void update(int id, const Vec3d &pos);
+    void remove(int id);
+    void clear(void);
+    bool contains(int id) const
+        {return id >= 0 && id < (int)items.size() && items[id].cell >= 0;}
+    int size(void) const {return count;}
+
+    /*! Ids of the points at angular distance from v not exceeding
+     *  acos(cosLim), appended to out in no particular order.
+     */
+    void query(const Vec3d &v, double cosLim, std::vector<int> &out) const;
+
+private:
+    struct Item
+    {
+        Item(): cell(-1), slot(0) {}
+        Vec3d pos;
+        int cell;   // -1 - точки нет
+        int slot;   // позиция в списке ячейки
+    };
+
+    double ringHeight;
+    std::vector<int> ringFirst;     // первая ячейка кольца, размер rings+1
+    std::vector<std::vector<int> > cells;
+    std::vector<Item> items;
+    int count;
+
+    int rings(void) const {return (int)ringFirst.size() - 1;}
+    int ringCells(int r) const {return ringFirst[r + 1] - ringFirst[r];}
+    int ringOf(double dec) const;
+    int cellOf(const Vec3d &v) const;
+    void scanCell(int c, const Vec3d &v, double cosLim,
+                  std::vector<int> &out) const;
+};
+
+#endif // _SPHEREINDEX_HPP_
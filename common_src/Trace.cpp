@@ -0,0 +1,175 @@
+#include "Trace.hpp"
+
+#ifdef SATTRAJ_TRACING
+
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+struct TraceEvent
+{
+    uint64_t begin, end;    // нс
+    const char *name;
+    int tid;
+};
+
+// кольцо событий одного потока, пишет только владелец
+struct TraceBuffer
+{
+    TraceEvent ev[Trace::bufEvents];
+    volatile uint64_t head; // число записанных событий
+    int tid;
+    bool free;              // поток завершился, буфер можно отдать другому
+};
+
+struct TraceName
+{
+    int tid;
+    std::string name;
+};
+
+// регистрация потоков и dump(), не запись событий
+static pthread_mutex_t regLock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<TraceBuffer*> buffers;
+static std::vector<TraceName> names;
+static int nextTid = 1;
+static pthread_key_t exitKey;
+static pthread_once_t keyOnce = PTHREAD_ONCE_INIT;
+static __thread TraceBuffer *own = NULL;
+
+static void release(void *p)
+{
+    pthread_mutex_lock(&regLock);
+    ((TraceBuffer*)p)->free = true;
+    pthread_mutex_unlock(&regLock);
+}
+
+static void makeKey(void)
+{
+    pthread_key_create(&exitKey, release);
+}
+
+// буфер вызывающего потока, при первом обращении - регистрация
+static TraceBuffer* attach(void)
+{
+    if (own)
+        return own;
+    pthread_once(&keyOnce, makeKey);
+    pthread_mutex_lock(&regLock);
+    TraceBuffer *b = NULL;
+    for (size_t i = 0; i < buffers.size() && !b; ++i)
+        if (buffers[i]->free)
+            b = buffers[i];
+    if (!b)
+    {   // события завершившихся потоков остаются до перезаписи
+        b = new TraceBuffer;
+        b->head = 0;
+        buffers.push_back(b);
+    }
+    b->tid = nextTid++;
+    b->free = false;
+    pthread_mutex_unlock(&regLock);
+    pthread_setspecific(exitKey, b);
+    own = b;
+    return b;
+}
+
+void Trace::record(const char *name, uint64_t begin, uint64_t end)
+{
+    TraceBuffer *b = attach();
+    const uint64_t h = b->head;
+    TraceEvent &e = b->ev[h & (bufEvents - 1)];
+    e.begin = begin;
+    e.end = end;
+    e.name = name;
+    e.tid = b->tid;
+    // событие записано раньше, чем его увидит dump()
+    __sync_synchronize();
+    b->head = h + 1;
+}
+
+void Trace::threadName(const char *name)
+{
+    const int tid = attach()->tid;
+    pthread_mutex_lock(&regLock);
+    TraceName n;
+    n.tid = tid;
+    n.name = name;
+    names.push_back(n);
+    pthread_mutex_unlock(&regLock);
+}
+
+bool Trace::enabled(void)
+{
+    return true;
+}
+
+bool Trace::dump(const char *path)
+{
+    std::vector<TraceEvent> events;
+    std::vector<TraceName> named;
+
+    // копирование колец: события, которые владелец мог начать
+    // перезаписывать за время копирования, отбрасываются
+    pthread_mutex_lock(&regLock);
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        const TraceBuffer &b = *buffers[i];
+        const uint64_t h1 = b.head;
+        __sync_synchronize();
+        const uint64_t from = h1 > (uint64_t)bufEvents? h1 - bufEvents: 0;
+        const size_t base = events.size();
+        for (uint64_t k = from; k < h1; ++k)
+            events.push_back(b.ev[k & (bufEvents - 1)]);
+        __sync_synchronize();
+        const uint64_t h2 = b.head;
+        if (h2 >= (uint64_t)bufEvents + from)
+        {
+            const uint64_t lost = h2 - bufEvents + 1 - from;
+            events.erase(events.begin() + base,
+                         events.begin() + base +
+                         (lost < h1 - from? lost: h1 - from));
+        }
+    }
+    named = names;
+    pthread_mutex_unlock(&regLock);
+
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return false;
+    const int pid = getpid();
+    fprintf(f, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (size_t i = 0; i < named.size(); ++i, first = false)
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                "\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first? "": ",\n",
+                pid, named[i].tid, named[i].name.c_str());
+    for (size_t i = 0; i < events.size(); ++i, first = false)
+        fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                "\"ts\":%.3f,\"dur\":%.3f}", first? "": ",\n",
+                events[i].name, pid, events[i].tid, events[i].begin*1e-3,
+                (events[i].end - events[i].begin)*1e-3);
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    const bool ok = !ferror(f);
+    return (fclose(f) == 0) && ok;
+}
+
+#else
+
+bool Trace::dump(const char * /*path*/)
+{
+    return false;
+}
+
+bool Trace::enabled(void)
+{
+    return false;
+}
+
+void Trace::threadName(const char * /*name*/)
+{
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef _TRACE_HPP_
+#define _TRACE_HPP_
+
+#include <stdint.h>
+#ifdef SATTRAJ_TRACING
+#include <time.h>
+#endif
+
+/*! \class Trace
+ *  \brief Scoped trace events in the Chrome trace-event format.
+ *
+ *  SATTRAJ_TRACE_SCOPE("name") records the rest of the enclosing scope as
+ *  one event of the calling thread, name must be a string literal.
+ *  SATTRAJ_TRACE_THREAD("name") names the calling thread in the trace.
+ *  Each thread writes to its own ring of the last bufEvents events without
+ *  locks; dump() may be called from any thread and writes the rings as
+ *  JSON for chrome://tracing or Perfetto.
+ *
+ *  The events are compiled in only with the ENABLE_TRACING CMake option
+ *  (SATTRAJ_TRACING defined). Otherwise the macros expand to nothing and
+ *  dump() returns false.
+ */
+class Trace
+{
+public:
+    static const int bufEvents = 1 << 15;   // степень двойки
+
+    //! false without SATTRAJ_TRACING or on a file error (errno is set)
+    static bool dump(const char *path);
+    static bool enabled(void);
+    static void threadName(const char *name);
+
+#ifdef SATTRAJ_TRACING
+    class Scope
+    {
+        Scope(const Scope&);
+        const Scope& operator=(const Scope&);
+
+    public:
+        explicit Scope(const char *n): name(n), begin(now()) {}
+        ~Scope() {record(name, begin, now());}
+
+    private:
+        const char *const name;
+        const uint64_t begin;
+    };
+
+    //! monotonic time, ns
+    static uint64_t now(void)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+    }
+    static void record(const char *name, uint64_t begin, uint64_t end);
+#endif
+};
+
+#ifdef SATTRAJ_TRACING
+#define SATTRAJ_TRACE_CAT_(a, b) a##b
+#define SATTRAJ_TRACE_CAT(a, b) SATTRAJ_TRACE_CAT_(a, b)
+#define SATTRAJ_TRACE_SCOPE(name) \
+    Trace::Scope SATTRAJ_TRACE_CAT(traceScope_, __LINE__)(name)
+#define SATTRAJ_TRACE_THREAD(name) Trace::threadName(name)
+#else
+#define SATTRAJ_TRACE_SCOPE(name) do {} while (0)
+#define SATTRAJ_TRACE_THREAD(name) do {} while (0)
+#endif
+
+#endif // _TRACE_HPP_
@@ -0,0 +1,325 @@
+#include "TrajBuffer.hpp"
+#include <algorithm>
+
+static uint64_t lastStamp = 0;
+
+TrajBuffer::TrajBuffer()
+  : head(0)
+  , count(0)
+  , mask(-1)
+  , seqFirst(0)
+  , stampVal(0)
+{
+    restamp();
+}
+
+TrajBuffer::TrajBuffer(int cap)
+  : head(0)
+  , count(0)
+  , mask(-1)
+  , seqFirst(0)
+  , stampVal(0)
+{
+    restamp();
+    reserve(cap);
+}
+
+void TrajBuffer::clear(void)
+{
+    head = 0;
+    count = 0;
+    restamp();
+}
+
+void TrajBuffer::reserve(int cap)
+{
+    if (cap > capacity())
+        grow(cap);
+}
+
+void TrajBuffer::swap(TrajBuffer &other)
+{
+    tCol.swap(other.tCol);
+    vCol.swap(other.vCol);
+    dCol.swap(other.dCol);
+    std::swap(head, other.head);
+    std::swap(count, other.count);
+    std::swap(mask, other.mask);
+    std::swap(seqFirst, other.seqFirst);
+    std::swap(stampVal, other.stampVal);
+}
+
+DataPoint TrajBuffer::at(int i) const
+{
+    DataPoint p;
+    const int s = slot(i);
+    p.time = tCol[s];
+    p.vec = vCol[s];
+    p.dist = dCol[s];
+    return p;
+}
+
+void TrajBuffer::append(uint64_t t, const Vec3d &v, double d)
+{
+    if (count == capacity())
+        grow(count + 1);
+    const int s = slot(count);
+    tCol[s] = t;
+    vCol[s] = v;
+    dCol[s] = d;
+    ++count;
+}
+
+void TrajBuffer::append(const TrajBuffer &src)
+{
+    appendTail(src, src.count);
+}
+
+int TrajBuffer::reserveTail(int n, Span span[2])
+{
+    if (n <= 0)
+        return 0;
+    reserve(count + n);
+    const int first = slot(count);
+    const int len = std::min(n, capacity() - first);
+    span[0].time = &tCol[first];
+    span[0].vec = &vCol[first];
+    span[0].dist = &dCol[first];
+    span[0].size = len;
+    if (len == n)
+        return 1;
+    span[1].time = &tCol[0];
+    span[1].vec = &vCol[0];
+    span[1].dist = &dCol[0];
+    span[1].size = n - len;
+    return 2;
+}
+
+void TrajBuffer::commitTail(int n)
+{
+    count += n;
+}
+
+void TrajBuffer::appendTail(const TrajBuffer &src, int n)
+{
+    reserve(count + n);
+    // границы до добавления: при &src == this src.count растёт в цикле
+    const int end = src.count;
+    for (int i = end - n; i < end; ++i)
+    {
+        const int s = src.slot(i);
+        append(src.tCol[s], src.vCol[s], src.dCol[s]);
+    }
+}
+
+void TrajBuffer::prepend(uint64_t t, const Vec3d &v, double d)
+{
+    if (count == capacity())
+        grow(count + 1);
+    head = (head - 1) & mask;
+    --seqFirst;
+    tCol[head] = t;
+    vCol[head] = v;
+    dCol[head] = d;
+    ++count;
+    restamp();
+}
+
+void TrajBuffer::removeFirst(int n)
+{
+    if (n <= 0)
+        return;
+    if (n >= count)
+    {
+        clear();
+        return;
+    }
+    head = slot(n);
+    count -= n;
+    seqFirst += n;
+}
+
+void TrajBuffer::removeLast(int n)
+{
+    if (n <= 0)
+        return;
+    if (n >= count)
+    {
+        clear();
+        return;
+    }
+    count -= n;
+    restamp();
+}
+
+int TrajBuffer::lowerBound(const xNtpTime &t) const
+{
+    int lo = 0, len = count;
+    while (len > 0)
+    {
+        const int half = len >> 1;
+        if (tCol[slot(lo + half)] < t.ext())
+        {
+            lo += half + 1;
+            len -= half + 1;
+        }
+        else
+            len = half;
+    }
+    return lo;
+}
+
+int TrajBuffer::upperBound(const xNtpTime &t) const
+{
+    int lo = 0, len = count;
+    while (len > 0)
+    {
+        const int half = len >> 1;
+        if (tCol[slot(lo + half)] <= t.ext())
+        {
+            lo += half + 1;
+            len -= half + 1;
+        }
+        else
+            len = half;
+    }
+    return lo;
+}
+
+void TrajBuffer::window(const xNtpTime &l, const xNtpTime &r,
+                        int &from, int &to) const
+{
+    from = lowerBound(l);
+    to = (from < count)? upperBound(r): count;
+    if (to < from)
+        to = from;
+}
+
+int TrajBuffer::segment(const xNtpTime &t, int hint) const
+{
+    const uint64_t te = t.ext();
+    // проверка курсора и следующего за ним отрезка
+    for (int i = hint; i >= 0 && i < hint + 2 && i < count - 1; ++i)
+    {
+        if (tCol[slot(i)] <= te && te < tCol[slot(i + 1)])
+            return i;
+    }
+    const int i = upperBound(t) - 1;
+    if (i < 0 || i >= count - 1)
+        return -1;
+    return i;
+}
+
+bool TrajBuffer::interpolate(const xNtpTime &t, DataPoint &p, int *cursor) const
+{
+    const int i = segment(t, cursor? *cursor: -1);
+    if (cursor)
+        *cursor = i;
+    if (i < 0)
+        return false;
+    const int s0 = slot(i), s1 = slot(i + 1);
+    const uint64_t t_down = tCol[s0], t_up = tCol[s1];
+    const double a = (double)(t.ext() - t_down)/(double)(t_up - t_down);
+    const double b = (double)(t_up - t.ext())/(double)(t_up - t_down);
+    p.vec[0] = vCol[s0][0]*b + vCol[s1][0]*a;
+    p.vec[1] = vCol[s0][1]*b + vCol[s1][1]*a;
+    p.vec[2] = vCol[s0][2]*b + vCol[s1][2]*a;
+    p.time = t;
+    p.dist = dCol[s0]*b + dCol[s1]*a;
+    return true;
+}
+
+int TrajBuffer::trimLeft(const xNtpTime &t)
+{
+    int n = 0;
+    while (n < count && tCol[slot(n)] <= t.ext())
+        ++n;
+    removeFirst(n);
+    return n;
+}
+
+void TrajBuffer::mirror(const TrajBuffer &src)
+{
+    if (&src == this)
+        return;
+    const int64_t end = seqFirst + count, srcEnd = src.seqFirst + src.count;
+    if (stampVal != src.stampVal || src.seqFirst < seqFirst ||
+        srcEnd < end || src.seqFirst >= end)
+    {
+        *this = src;
+        return;
+    }
+    removeFirst((int)(src.seqFirst - seqFirst));
+    appendTail(src, (int)(srcEnd - end));
+}
+
+int TrajBuffer::trimRight(const xNtpTime &t)
+{
+    int n = 0;
+    while (n < count && tCol[slot(count - 1 - n)] >= t.ext())
+        ++n;
+    removeLast(n);
+    return n;
+}
+
+int TrajBuffer::removeUnordered(void)
+{
+    if (count < 2)
+        return 0;
+    // оставленные точки сдвигаются к концу буфера
+    int w = count - 1;
+    bool moved = false;
+    uint64_t lastGood = tCol[slot(w)];
+    for (int r = count - 2; r >= 0; --r)
+    {
+        const uint64_t t = tCol[slot(r)];
+        if (t > lastGood)
+            continue;
+        lastGood = t;
+        if (--w != r)
+        {
+            moveSlot(slot(r), slot(w));
+            moved = true;
+        }
+    }
+    head = slot(w);
+    count -= w;
+    seqFirst += w;
+    if (moved)
+        restamp();
+    return w;
+}
+
+void TrajBuffer::moveSlot(int from, int to)
+{
+    tCol[to] = tCol[from];
+    vCol[to] = vCol[from];
+    dCol[to] = dCol[from];
+}
+
+void TrajBuffer::restamp(void)
+{
+    stampVal = __sync_add_and_fetch(&lastStamp, 1);
+}
+
+void TrajBuffer::grow(int minCap)
+{
+    int cap = minCapacity;
+    while (cap < minCap)
+        cap <<= 1;
+    std::vector<uint64_t> t(cap);
+    std::vector<Vec3d> v(cap);
+    std::vector<double> d(cap);
+    for (int i = 0; i < count; ++i)
+    {
+        const int s = slot(i);
+        t[i] = tCol[s];
+        v[i] = vCol[s];
+        d[i] = dCol[s];
+    }
+    tCol.swap(t);
+    vCol.swap(v);
+    dCol.swap(d);
+    head = 0;
+    mask = cap - 1;
+}
@@ -0,0 +1,125 @@
+#ifndef _TRAJBUFFER_HPP_
+#define _TRAJBUFFER_HPP_
+
+#include "VecMath.hpp"
+#include "xNtpTime.hpp"
+#include <vector>
+
+struct DataPoint
+{
+    DataPoint(void): time((uint64_t)0) {}
+
+    xNtpTime time;
+    Vec3d vec;
+    double dist;
+};
+Q_DECLARE_TYPEINFO(DataPoint, Q_PRIMITIVE_TYPE);
+
+/*! \class TrajBuffer
+ *  \brief Time-ordered storage of trajectory points.
+ *
+ *  Contiguous growable ring buffer with separate columns for time,
+ *  direction vector and distance. Adding and removing points at both ends
+ *  is amortised O(1) and does not allocate per point. Index 0 is always
+ *  the oldest point.
+ */
+class TrajBuffer
+{
+public:
+    TrajBuffer();
+    explicit TrajBuffer(int cap);
+
+    int size(void) const {return count;}
+    bool isEmpty(void) const {return !count;}
+    int capacity(void) const {return mask + 1;}
+    void clear(void);
+    void reserve(int cap);
+    void swap(TrajBuffer &other);
+
+    /* Сквозной номер точки. Пока stamp() не изменился, номер однозначно
+     * определяет точку: добавление в конец и удаление из начала буфера
+     * stamp() не меняют, остальные изменения меняют.
+     */
+    int64_t seq(int i) const {return seqFirst + i;}
+    int indexOf(int64_t s) const {return (int)(s - seqFirst);}
+    uint64_t stamp(void) const {return stampVal;}
+
+    uint64_t timeExt(int i) const {return tCol[slot(i)];}
+    xNtpTime time(int i) const {return xNtpTime(tCol[slot(i)]);}
+    const Vec3d& vec(int i) const {return vCol[slot(i)];}
+    double dist(int i) const {return dCol[slot(i)];}
+    DataPoint at(int i) const;
+    xNtpTime firstTime(void) const {return time(0);}
+    xNtpTime lastTime(void) const {return time(count - 1);}
+
+    void append(const DataPoint &p) {append(p.time.ext(), p.vec, p.dist);}
+    void append(uint64_t t, const Vec3d &v, double d);
+    void append(const TrajBuffer &src);
+    void prepend(const DataPoint &p) {prepend(p.time.ext(), p.vec, p.dist);}
+    void prepend(uint64_t t, const Vec3d &v, double d);
+    void removeFirst(int n = 1);
+    void removeLast(int n = 1);
+
+    // непрерывный участок колонок для заполнения на месте
+    struct Span
+    {
+        uint64_t *time;
+        Vec3d *vec;
+        double *dist;
+        int size;
+    };
+    /* Резервирование n мест после последней точки без копирования через
+     * промежуточные буферы. Места описываются одним или двумя (при
+     * переходе через конец кольца) участками, возвращается их число.
+     * Заполненные места становятся точками буфера после commitTail(n).
+     */
+    int reserveTail(int n, Span span[2]);
+    void commitTail(int n);
+    // добавление n последних точек src
+    void appendTail(const TrajBuffer &src, int n);
+    /* Приведение к src. Если буфер - более ранняя копия src (метки равны),
+     * удаляются точки из начала и добавляются новые точки в конец, метка
+     * и номера точек сохраняются; иначе src копируется целиком.
+     */
+    void mirror(const TrajBuffer &src);
+
+    // первый индекс с временем >= t (size(), если такого нет)
+    int lowerBound(const xNtpTime &t) const;
+    // первый индекс с временем > t (size(), если такого нет)
+    int upperBound(const xNtpTime &t) const;
+    // диапазон индексов [from, to) точек с временем в окне [l, r]
+    void window(const xNtpTime &l, const xNtpTime &r, int &from, int &to) const;
+    /* Индекс i отрезка, для которого time(i) <= t < time(i+1), или -1.
+     * hint - результат предыдущего поиска (курсор): при последовательных
+     * запросах с растущим временем поиск занимает O(1).
+     */
+    int segment(const xNtpTime &t, int hint = -1) const;
+    // линейная интерполяция точки на момент t, false если t вне буфера
+    bool interpolate(const xNtpTime &t, DataPoint &p, int *cursor = 0) const;
+
+    // удаление точек с временем <= t с начала буфера
+    int trimLeft(const xNtpTime &t);
+    // удаление точек с временем >= t с конца буфера
+    int trimRight(const xNtpTime &t);
+    // удаление точек, нарушающих порядок по времени (просмотр с конца)
+    int removeUnordered(void);
+
+private:
+    std::vector<uint64_t> tCol;
+    std::vector<Vec3d> vCol;
+    std::vector<double> dCol;
+    int head;   // physical index of the oldest point
+    int count;
+    int mask;   // capacity - 1, capacity is a power of two
+    int64_t seqFirst;
+    uint64_t stampVal;
+
+    int slot(int i) const {return (head + i) & mask;}
+    void grow(int minCap);
+    void moveSlot(int from, int to);
+    void restamp(void);
+
+    static const int minCapacity = 64;
+};
+
+#endif // _TRAJBUFFER_HPP_
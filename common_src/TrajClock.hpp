@@ -0,0 +1,21 @@
+#ifndef _TRAJCLOCK_HPP_
+#define _TRAJCLOCK_HPP_
+
+#include "xNtpTime.hpp"
+
+/*! \class TrajClock
+ *  \brief Source of the model time for trajectory stores.
+ *
+ *  The plugins return the Stellarium time (it may run at any rate, stop
+ *  or go back), tools and benchmarks return their own.
+ */
+class TrajClock
+{
+public:
+    virtual ~TrajClock() {}
+
+    //! current model time in NTP format
+    virtual void now(xNtpTime &t) const =0;
+};
+
+#endif // _TRAJCLOCK_HPP_
@@ -0,0 +1,83 @@
+#include "TrajFetcher.hpp"
+#include "Trace.hpp"
+
+TrajFetcher::TrajFetcher(MYSQL *m, int type)
+  : mysql(m)
+  , qType(type)
+  , rTime(0)
+  , rAz(0.)
+  , rEl(0.)
+  , rDist(0.)
+  , rId(0)
+{
+}
+
+bool TrajFetcher::fetch(TrajStore &store, const std::string &table,
+                        bool meas)
+{
+    if (!store.beginUpdate(range))
+        return false;
+    prepareStmts(table, meas);
+    if (range.rRight)
+        sendParseQuery(store, stmtRight);
+    if (range.lRight)
+        sendParseQuery(store, stmtLeft, true);
+    store.finishUpdate();
+    return true;
+}
+
+void TrajFetcher::close(void)
+{
+    // подготавливаются заново при следующем fetch()
+    stmtRight.reset();
+    stmtLeft.reset();
+    stmtTable.clear();
+}
+
+void TrajFetcher::prepareStmts(const std::string &table, bool meas)
+{
+    if (stmtRight.isPrepared() && stmtTable == table)
+        return;
+    stmtRight.reset();
+    stmtLeft.reset();
+    const std::string cols = meas? "SELECT Time,pAz,pUm,Dist,ID FROM ":
+                                   "SELECT Time,Az,Um,Dist,ID FROM ";
+    const std::string typeCond = meas? " WHERE ": " WHERE Type=? AND ";
+
+    stmtRight.prepare(mysql, cols + table + typeCond +
+                      "Time>? AND Time<? AND (ID>? OR Time>?) ORDER BY ID ASC");
+    if (!meas)
+        stmtRight.addParam(MYSQL_TYPE_LONG, &qType);
+    stmtRight.addParam(MYSQL_TYPE_LONGLONG, &range.rLeft, true);
+    stmtRight.addParam(MYSQL_TYPE_LONGLONG, &range.rRight, true);
+    stmtRight.addParam(MYSQL_TYPE_LONG, &range.rId);
+    stmtRight.addParam(MYSQL_TYPE_LONGLONG, &range.rLast, true);
+    stmtRight.addResult(MYSQL_TYPE_LONGLONG, &rTime, true);
+    stmtRight.addResult(MYSQL_TYPE_DOUBLE, &rAz);
+    stmtRight.addResult(MYSQL_TYPE_DOUBLE, &rEl);
+    stmtRight.addResult(MYSQL_TYPE_DOUBLE, &rDist);
+    stmtRight.addResult(MYSQL_TYPE_LONG, &rId);
+
+    stmtLeft.prepare(mysql, cols + table + typeCond +
+                     "Time>? AND Time<? ORDER BY ID DESC");
+    if (!meas)
+        stmtLeft.addParam(MYSQL_TYPE_LONG, &qType);
+    stmtLeft.addParam(MYSQL_TYPE_LONGLONG, &range.lLeft, true);
+    stmtLeft.addParam(MYSQL_TYPE_LONGLONG, &range.lRight, true);
+    stmtLeft.addResult(MYSQL_TYPE_LONGLONG, &rTime, true);
+    stmtLeft.addResult(MYSQL_TYPE_DOUBLE, &rAz);
+    stmtLeft.addResult(MYSQL_TYPE_DOUBLE, &rEl);
+    stmtLeft.addResult(MYSQL_TYPE_DOUBLE, &rDist);
+    stmtLeft.addResult(MYSQL_TYPE_LONG, &rId);
+
+    stmtTable = table;
+}
+
+void TrajFetcher::sendParseQuery(TrajStore &store, DbStmt &stmt, bool prepend)
+{
+    SATTRAJ_TRACE_SCOPE("TrajFetcher::sendParseQuery");
+    stmt.execute();
+    while (stmt.fetch())
+        store.appendRow(prepend, rTime, rAz, rEl, rDist, rId);
+    stmt.freeResult();
+}
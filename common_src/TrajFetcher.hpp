@@ -0,0 +1,48 @@
+#ifndef _TRAJFETCHER_HPP_
+#define _TRAJFETCHER_HPP_
+
+#include "DbStmt.hpp"
+#include "TrajStore.hpp"
+#include <mysql/mysql.h>
+#include <string>
+
+/*! \class TrajFetcher
+ *  \brief Separate DB update of one TrajStore with prepared statements.
+ *
+ *  Fetches the ranges of TrajStore::beginUpdate() from a trajectory
+ *  table (Type column = type) or from a measurement table (no Type
+ *  column, measured az/el). The statements are prepared again when the
+ *  table changes.
+ */
+class TrajFetcher
+{
+    TrajFetcher(const TrajFetcher&);
+    const TrajFetcher& operator=(const TrajFetcher&);
+
+public:
+    TrajFetcher(MYSQL *mysql, int type);
+
+    //! false - update not needed; throws std::runtime_error on DB errors
+    bool fetch(TrajStore &store, const std::string &table, bool meas);
+    //! close the statements before the connection is closed
+    void close(void);
+
+private:
+    MYSQL *mysql;
+
+    // подготовленные запросы правой (или всего окна) и левой частей окна
+    DbStmt stmtRight, stmtLeft;
+    std::string stmtTable;  // таблица, для которой подготовлены запросы
+    // параметры запросов
+    int qType;
+    DbFetchRange range;
+    // буферы строки результата
+    unsigned long long rTime;
+    double rAz, rEl, rDist;
+    int rId;
+
+    void prepareStmts(const std::string &table, bool meas);
+    void sendParseQuery(TrajStore &store, DbStmt &stmt, bool prepend = false);
+};
+
+#endif // _TRAJFETCHER_HPP_
@@ -0,0 +1,128 @@
+#include "TrajLod.hpp"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+const double TrajLod::tolMin = 1e-5;
+
+TrajLod::TrajLod()
+  : stamp(0)
+{
+}
+
+void TrajLod::invalidate(void)
+{
+    blocks.clear();
+    verts.clear();
+    stamp = 0;
+}
+
+int64_t TrajLod::blockOf(int64_t seq)
+{
+    // номера точек отрицательны после добавления в начало буфера
+    return seq >= 0? seq / blockSize: -((-seq + blockSize - 1) / blockSize);
+}
+
+bool TrajLod::update(const TrajBuffer &traj, int from, int to, double tol)
+{
+    int lev = -1;
+    for (double t = tolMin; lev + 1 < levels && t <= tol; t *= 4.)
+        ++lev;
+    if (lev < 0)
+        return false;
+
+    if (stamp != traj.stamp())
+    {
+        blocks.clear();
+        stamp = traj.stamp();
+    }
+    verts.clear();
+    if (to - from < 3)
+    {
+        for (int i = from; i < to; ++i)
+            verts.push_back(traj.vec(i));
+        return true;
+    }
+
+    const int64_t sf = traj.seq(from), sl = traj.seq(to - 1);
+    const int64_t bf = blockOf(sf), bl = blockOf(sl);
+    // блоки вне окна отрисовки больше не нужны
+    blocks.erase(blocks.begin(), blocks.lower_bound(bf));
+    blocks.erase(blocks.upper_bound(bl), blocks.end());
+
+    const int64_t s0 = traj.seq(0), sEnd = traj.seq(traj.size());
+    // края окна берутся всегда, иначе линия укорачивается
+    verts.push_back(traj.vec(from));
+    for (int64_t b = bf; b <= bl; ++b)
+    {
+        const int64_t first = std::max(b * blockSize, s0);
+        const int count = (int)(std::min((b + 1) * blockSize, sEnd) - first);
+        Block &blk = blocks[b];
+        if (blk.pts.empty() || blk.first != first || blk.count != count)
+            build(blk, traj, traj.indexOf(first), count);
+        const std::vector<int> &idx = blk.level[lev];
+        for (size_t i = 0; i < idx.size(); ++i)
+        {
+            const int64_t s = blk.first + idx[i];
+            if (s > sf && s < sl)
+                verts.push_back(blk.pts[idx[i]]);
+        }
+    }
+    verts.push_back(traj.vec(to - 1));
+    return true;
+}
+
+void TrajLod::build(Block &blk, const TrajBuffer &traj, int from, int count)
+{
+    blk.first = traj.seq(from);
+    blk.count = count;
+    blk.pts.resize(count);
+    for (int i = 0; i < count; ++i)
+        blk.pts[i] = traj.vec(from + i);
+
+    // Douglas-Peucker: погрешность точки не больше погрешности точки,
+    // разделившей охватывающий участок, поэтому уровни вложены
+    err.assign(count, 0.f);
+    err[0] = err[count - 1] = FLT_MAX;
+    stack.clear();
+    if (count > 2)
+        stack.push_back(std::make_pair(0, count - 1));
+    while (!stack.empty())
+    {
+        const int a = stack.back().first, b = stack.back().second;
+        stack.pop_back();
+        const Vec3d &pa = blk.pts[a];
+        const Vec3d ab = blk.pts[b] - pa;
+        const double ab2 = ab.lengthSquared();
+        int k = a + 1;
+        double dmax = -1.;
+        for (int i = a + 1; i < b; ++i)
+        {
+            // расстояние до хорды, для малых углов равно угловому
+            const Vec3d ap = blk.pts[i] - pa;
+            double t = ab2 > 0.? ap.dot(ab) / ab2: 0.;
+            t = std::min(1., std::max(0., t));
+            const double d = (ap - ab * t).lengthSquared();
+            if (d > dmax)
+            {
+                dmax = d;
+                k = i;
+            }
+        }
+        err[k] = std::min((float)sqrt(dmax), std::min(err[a], err[b]));
+        if (k - a > 1)
+            stack.push_back(std::make_pair(a, k));
+        if (b - k > 1)
+            stack.push_back(std::make_pair(k, b));
+    }
+
+    double tol = tolMin;
+    for (int l = 0; l < levels; ++l, tol *= 4.)
+    {
+        std::vector<int> &idx = blk.level[l];
+        idx.clear();
+        for (int i = 0; i < count; ++i)
+            if (err[i] >= tol)
+                idx.push_back(i);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef _TRAJLOD_HPP_
+#define _TRAJLOD_HPP_
+
+#include "TrajBuffer.hpp"
+#include <map>
+
+/*! \class TrajLod
+ *  \brief Levels of detail of a trajectory polyline on the unit sphere.
+ *
+ *  Points are split into blocks of blockSize consecutive numbers
+ *  (TrajBuffer::seq). Every block is simplified once by Douglas-Peucker:
+ *  each point gets the angular error at which it is dropped, and level k
+ *  keeps the points with error >= tolMin*4^k. Block ends are always kept,
+ *  so the levels of adjacent blocks join into one line strip. A block is
+ *  rebuilt only when its points change, i.e. for the growing tail and the
+ *  trimmed head of the buffer or after a change of the buffer stamp.
+ */
+class TrajLod
+{
+public:
+    TrajLod();
+
+    /* Отбор вершин точек [from, to) traj с угловой погрешностью не более
+     * tol (рад). false - tol меньше погрешности самого подробного уровня,
+     * нужна полная траектория (TrajVertexCache).
+     */
+    bool update(const TrajBuffer &traj, int from, int to, double tol);
+    void invalidate(void);
+    const Vec3d* data(void) const {return verts.empty()? 0: &verts[0];}
+    int size(void) const {return (int)verts.size();}
+    bool isEmpty(void) const {return verts.empty();}
+
+    static const int blockSize = 1024;
+    static const int levels = 7;
+    static const double tolMin;     // погрешность уровня 0, рад
+
+private:
+    struct Block
+    {
+        int64_t first;              // номер первой точки блока
+        int count;
+        std::vector<Vec3d> pts;
+        std::vector<int> level[levels]; // индексы точек уровня в pts
+    };
+
+    std::map<int64_t, Block> blocks;   // по номеру блока
+    std::vector<Vec3d> verts;
+    uint64_t stamp;
+    // для отбора погрешностей в build(), сохраняются между вызовами
+    std::vector<float> err;
+    std::vector<std::pair<int, int> > stack;
+
+    void build(Block &blk, const TrajBuffer &traj, int from, int count);
+    static int64_t blockOf(int64_t seq);
+};
+
+#endif // _TRAJLOD_HPP_
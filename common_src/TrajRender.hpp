@@ -0,0 +1,25 @@
+#ifndef _TRAJRENDER_HPP_
+#define _TRAJRENDER_HPP_
+
+#include "VecMath.hpp"
+
+/*! \class TrajRender
+ *  \brief Drawing of prepared trajectory vertices.
+ *
+ *  Vertices are directions in the Alt/Az frame. The plugins draw through
+ *  StelPainter, tools may count vertices or draw nothing.
+ */
+class TrajRender
+{
+public:
+    virtual ~TrajRender() {}
+
+    virtual void setColor(float r, float g, float b) =0;
+    virtual void lineStrip(const Vec3d *v, int n) =0;
+    //! points of size pixels with per-point colours
+    virtual void points(const Vec3d *v, const Vec4f *c, int n, float size) =0;
+    //! scale at the centre of the view, pixels per radian
+    virtual double pixelPerRad(void) const =0;
+};
+
+#endif // _TRAJRENDER_HPP_
@@ -0,0 +1,453 @@
+#include "TrajStore.hpp"
+#include "TrajClock.hpp"
+#include "AzElConv.hpp"
+#include "Trace.hpp"
+
+// окно хранения относительно окна отрисовки (>1)
+static const float wndRelSize = 4.f;
+// задержки до кадра больше этой - модельное время не текущее
+static const double e2eMax = 600.;
+
+TrajStore::Meters::Meters(void)
+  : shmPoints(NULL)
+  , dbPoints(NULL)
+  , wait(NULL)
+  , shmBatch(NULL)
+  , dbRows(NULL)
+  , prep(NULL)
+  , e2e(NULL)
+  , held(NULL)
+{
+}
+
+TrajStore::TrajStore(int chan, const TrajClock &c, const unsigned &tw,
+                     const int &maxPoints, FeedLog *const &log)
+  : channel(chan)
+  , clock(c)
+  , timeWindow(tw)
+  , shmMaxPoints(maxPoints)
+  , feedLog(log)
+  , updReq(true)
+  , lastIdUpd(-1)
+  , drawCursor(-1)
+  , findCursor(-1)
+  , evictedPoints(0)
+  , overflowPoints(0)
+  , updRows(0)
+  , waitSeen(0)
+{
+}
+
+void TrajStore::setMetrics(Metrics &m, const std::string &source)
+{
+    meters = registerMeters(m, source);
+}
+
+TrajStore::Meters TrajStore::registerMeters(Metrics &m,
+                                            const std::string &source)
+{
+    Meters r;
+    const std::string src = "source=\"" + source + "\"";
+    r.shmPoints = &m.counter("sattraj_ingest_points_total",
+        "Points received", src + ",feed=\"shm\"");
+    r.dbPoints = &m.counter("sattraj_ingest_points_total",
+        "Points received", src + ",feed=\"db\"");
+    r.wait = &m.counter("sattraj_reader_wait_seconds_total",
+        "Time writers waited for readers to leave an instance", src, 1e-9);
+    r.shmBatch = &m.histogram("sattraj_shm_batch_records",
+        "Records per shared memory read", src, 1., 2., 16);
+    r.dbRows = &m.histogram("sattraj_db_update_rows",
+        "Rows per DB update", src, 1., 2., 16);
+    r.prep = &m.histogram("sattraj_draw_prep_seconds",
+        "Per-frame line and position preparation time", src, 1e-6, 2., 20);
+    r.e2e = &m.histogram("sattraj_e2e_latency_seconds",
+        "Point timestamp to first frame showing it", src, 1e-3, 2., 16);
+    r.held = &m.gauge("sattraj_points_held",
+        "Points in the published trajectory", src);
+    return r;
+}
+
+void TrajStore::storeWindow(const xNtpTime &stelT, unsigned timeWindow,
+                            xNtpTime &l_time, xNtpTime &r_time)
+{
+    if (timeWindow < 300)
+    {
+        l_time = stelT - 300.;
+        r_time = stelT + 300.;
+    }
+    else
+    {
+        l_time = stelT - xNtpTime((u64)(timeWindow * wndRelSize) << 32);
+        r_time = stelT + xNtpTime((u64)(timeWindow * wndRelSize) << 32);
+    }
+}
+
+bool TrajStore::beginUpdate(DbFetchRange &req)
+{
+    req.setEmpty();
+    if (!updReq)
+        return false;
+
+    xNtpTime stelT, l_time, r_time, ld_time, rd_time;
+
+    clock.now(stelT);
+    storeWindow(stelT, timeWindow, l_time, r_time);
+    ld_time = stelT - xNtpTime((u64)timeWindow << 32);
+    rd_time = stelT + xNtpTime((u64)timeWindow << 32);
+    // Удаление лишних точек
+    trajUpd.trimLeft(l_time);
+    trajUpd.trimRight(r_time);
+    recWindow.lTime = l_time.ext();
+    recWindow.rTime = r_time.ext();
+    recRows.clear();
+    updRows = 0;
+    if (trajUpd.isEmpty())
+    {   // Запрос всего окна по времени
+        req.rLeft = l_time.ext();
+        req.rRight = r_time.ext();
+        return true;
+    }
+    // Проверка хвостов
+    if (trajUpd.lastTime() < rd_time)
+    {   // запрос правой части окна
+        req.rLeft = l_time.ext();
+        req.rRight = r_time.ext();
+        req.rLast = trajUpd.lastTime().ext();
+        req.rId = lastIdUpd;
+    }
+    if (trajUpd.firstTime() > ld_time)
+    {   // запрос левой части окна
+        req.lLeft = l_time.ext();
+        req.lRight = trajUpd.firstTime().ext();
+    }
+    return true;
+}
+
+void TrajStore::appendRow(bool prepend, unsigned long long t, double az,
+                          double el, double dist, int id)
+{
+    DataPoint tmp;
+
+    ++updRows;
+    if (feedLog)
+    {
+        FeedLog::DbRow row;
+        row.time = t;
+        row.az = az;
+        row.el = el;
+        row.dist = dist;
+        row.id = id;
+        row.prepend = prepend;
+        recRows.push_back(row);
+    }
+    // левая часть окна запрашивается по убыванию ID
+    if (!prepend)
+        lastIdUpd = id;
+    tmp.time = (u64)t;
+    tmp.vec = AzElConv::toVec(az, el);
+    tmp.dist = dist;
+    if (prepend)
+        trajUpd.prepend(tmp);
+    else
+        trajUpd.append(tmp);
+}
+
+void TrajStore::finishUpdate(void)
+{
+    SATTRAJ_TRACE_SCOPE("TrajStore::finishUpdate");
+    if (feedLog)
+    {
+        xNtpTime stelT;
+        clock.now(stelT);
+        feedLog->write(FeedLog::DbRows, channel, stelT.ext(),
+                       &recWindow, sizeof(recWindow),
+                       recRows.empty()? NULL: &recRows[0],
+                       recRows.size()*sizeof(FeedLog::DbRow));
+    }
+    if (meters.dbRows)
+    {
+        meters.dbRows->observe(updRows);
+        meters.dbPoints->add(updRows);
+    }
+    // удаление перекрывающихся по времени участков
+    trajUpd.removeUnordered();
+    // оба экземпляра догоняют trajUpd по краям с сохранением метки, чтобы
+    // кэши отрисовки не перестраивались после каждого обновления
+    TrajBuffer &standby = trajDraw.beginWrite();
+    standby.mirror(trajUpd);
+    trajDraw.publish().mirror(trajUpd);
+    updReq = false;
+    endWrite();
+}
+
+void TrajStore::replayUpdate(const FeedLog::DbWindow &w,
+                             const FeedLog::DbRow *rows, int n)
+{
+    // окно то же, по которому обрезалась траектория при записи
+    trajUpd.trimLeft(xNtpTime(w.lTime));
+    trajUpd.trimRight(xNtpTime(w.rTime));
+    for (int i = 0; i < n; ++i)
+        appendRow(rows[i].prepend != 0, rows[i].time, rows[i].az, rows[i].el,
+                  rows[i].dist, rows[i].id);
+    finishUpdate();
+}
+
+void TrajStore::appendShm(Decoder decode, const void *data, int n,
+                          size_t recSize)
+{
+    SATTRAJ_TRACE_SCOPE("TrajStore::appendShm");
+    if (feedLog)
+    {
+        xNtpTime stelT;
+        clock.now(stelT);
+        feedLog->write(FeedLog::ShmBatch, channel, stelT.ext(), data,
+                       n*recSize);
+    }
+    if (meters.shmBatch)
+    {
+        meters.shmBatch->observe(n);
+        meters.shmPoints->add(n);
+    }
+    // декодирование прямо в конец отрисовываемой траектории
+    TrajBuffer &standby = trajDraw.beginWrite();
+    TrajBuffer::Span span[2];
+    const int nSpans = standby.reserveTail(n, span);
+    for (int i = 0, done = 0; i < nSpans; done += span[i].size, ++i)
+        decode((const char*)data + done*recSize, span[i]);
+    standby.commitTail(n);
+    endAppend(standby, n);
+}
+
+void TrajStore::endAppend(TrajBuffer &standby, int n)
+{
+    xNtpTime stelT, l_time, r_time;
+    clock.now(stelT);
+    storeWindow(stelT, timeWindow, l_time, r_time);
+
+    const int oldSize = standby.size() - n;
+    const int evicted = standby.trimLeft(l_time);
+    int overflow = 0;
+    if (shmMaxPoints > 0 && standby.size() > shmMaxPoints)
+    {
+        overflow = standby.size() - shmMaxPoints;
+        standby.removeFirst(overflow);
+    }
+    // второй экземпляр изменяется так же, чтобы номера и метки совпадали
+    TrajBuffer &other = trajDraw.publish();
+    if (evicted + overflow > oldSize)
+    {
+        other = standby;
+    }
+    else
+    {
+        other.appendTail(standby, n);
+        other.removeFirst(evicted + overflow);
+    }
+    evictedPoints += evicted;
+    overflowPoints += overflow;
+    endWrite();
+}
+
+void TrajStore::endWrite(void)
+{
+    if (meters.wait)
+    {
+        const unsigned long long ns = trajDraw.waitNs();
+        meters.wait->add(ns - waitSeen);
+        waitSeen = ns;
+    }
+    trajDraw.endWrite();
+}
+
+void TrajStore::trim(void)
+{
+    endAppend(trajDraw.beginWrite(), 0);
+}
+
+void TrajStore::clear(void)
+{
+    // копирование сохраняет одинаковые метки у обоих экземпляров
+    TrajBuffer &standby = trajDraw.beginWrite();
+    standby.clear();
+    trajDraw.publish() = standby;
+    trajUpd.clear();
+    shownLast = xNtpTime();
+    lastIdUpd = 0;
+    evictedPoints = 0;
+    overflowPoints = 0;
+    endWrite();
+}
+
+bool TrajStore::prepare(double tol, bool extrapolate, double extrTime,
+                        Frame &out)
+{
+    const double t0 = meters.prep? Metrics::monoTime(): 0.;
+    LeftRight<TrajBuffer>::Reader reader(trajDraw);
+    const TrajBuffer &traj = reader.get();
+    if (traj.isEmpty())
+    {
+        updReq = true;
+        return false;
+    }
+
+    xNtpTime stelT;
+    bool setCurP;
+    int curP;
+
+    // Проверка хвостов траекторий на принадлежность окну отрисовки
+    clock.now(stelT);
+    xNtpTime l_time = stelT - xNtpTime((u64)timeWindow << 32);
+    xNtpTime r_time = stelT + xNtpTime((u64)timeWindow << 32);
+    if (traj.lastTime() < r_time)
+    {
+        updReq = true;
+    }
+    if (traj.firstTime() > l_time)
+    {
+        updReq = true;
+    }
+
+    // Отбор отрисовываемых точек, в кэше обновляются только изменившиеся края
+    int from, to;
+    traj.window(l_time, r_time, from, to);
+    const bool useLod = lineLod.update(traj, from, to, tol);
+    if (!useLod)
+        lineCache.update(traj, from, to);
+    out.line = useLod? lineLod.data(): lineCache.data();
+    out.lineSize = useLod? lineLod.size(): lineCache.size();
+    out.drawExtr = false;
+
+    // Поиск отрезка, содержащего текущее время (курсор с прошлого кадра)
+    curP = traj.segment(stelT, drawCursor);
+    drawCursor = curP;
+    setCurP = (curP >= 0) && (traj.time(curP+1) <= r_time);
+
+    Vec3d &XYZ = out.pos;
+    if (!setCurP)
+    {   // Точка текущего положения берётся с края массива
+        if (traj.time(0) > stelT)
+        {
+            curP = 0;
+            XYZ = traj.vec(curP);
+        }
+        else
+        {
+            curP = traj.size() - 1;
+            // применить экстраполяцию отображаемой траектории
+            if (extrapolate && (traj.size() > 2))
+            {
+                Vec3d tmp;
+                tmp[0] = traj.vec(curP)[0] +
+                    (traj.vec(curP)[0]-traj.vec(curP-1)[0])/
+                    (traj.time(curP)-traj.time(curP-1)).doub()*
+                    extrTime;
+                tmp[1] = traj.vec(curP)[1] +
+                    (traj.vec(curP)[1]-traj.vec(curP-1)[1])/
+                    (traj.time(curP)-traj.time(curP-1)).doub()*
+                    extrTime;
+                tmp[2] = traj.vec(curP)[2] +
+                    (traj.vec(curP)[2]-traj.vec(curP-1)[2])/
+                    (traj.time(curP)-traj.time(curP-1)).doub()*
+                    extrTime;
+                tmp.normalize();
+                out.extr[0] = traj.vec(curP);
+                out.extr[1] = tmp;
+                out.drawExtr = (to == traj.size());
+
+                uint64_t t_down, t_up, t_t;
+                double a, b;
+                t_down = traj.time(curP).ext();
+                t_up = (traj.time(curP) + extrTime).ext();
+                t_t = stelT.ext();
+                a = (double)(t_t - t_down)/(double)(t_up - t_down);
+                b = (double)(t_up - t_t)/(double)(t_up - t_down);
+                XYZ[0] = traj.vec(curP)[0]*b + tmp[0]*a;
+                XYZ[1] = traj.vec(curP)[1]*b + tmp[1]*a;
+                XYZ[2] = traj.vec(curP)[2]*b + tmp[2]*a;
+            }
+            else
+                XYZ = traj.vec(curP);
+        }
+    }
+    else
+    {
+        uint64_t t_down, t_up, t_t;
+        double a, b;
+        t_down = traj.time(curP).ext();
+        t_up = traj.time(curP+1).ext();
+        t_t = stelT.ext();
+        a = (double)(t_t - t_down)/(double)(t_up - t_down);
+        b = (double)(t_up - t_t)/(double)(t_up - t_down);
+        XYZ[0] = traj.vec(curP)[0]*b + traj.vec(curP+1)[0]*a;
+        XYZ[1] = traj.vec(curP)[1]*b + traj.vec(curP+1)[1]*a;
+        XYZ[2] = traj.vec(curP)[2]*b + traj.vec(curP+1)[2]*a;
+    }
+    out.range = traj.dist(curP);
+    frameDone(traj, t0);
+    return true;
+}
+
+bool TrajStore::preparePoints(double fadeWindow, const Vec3f &rgb,
+                              MeasPointBatch &out)
+{
+    const double t0 = meters.prep? Metrics::monoTime(): 0.;
+    LeftRight<TrajBuffer>::Reader reader(trajDraw);
+    const TrajBuffer &traj = reader.get();
+    if (traj.isEmpty())
+    {
+        updReq = true;
+        return false;
+    }
+
+    xNtpTime stelT;
+
+    // Проверка хвостов траекторий на принадлежность окну отрисовки
+    clock.now(stelT);
+    xNtpTime l_time = stelT - fadeWindow;
+    xNtpTime r_time = stelT + fadeWindow;
+    if (traj.lastTime() < r_time)
+    {
+        updReq = true;
+    }
+    if (traj.firstTime() > l_time)
+    {
+        updReq = true;
+    }
+
+    // Отбор отрисовываемых точек с расчётом прозрачности по возрасту
+    out.build(traj, stelT, fadeWindow, rgb);
+    frameDone(traj, t0);
+    return true;
+}
+
+void TrajStore::frameDone(const TrajBuffer &traj, double t0)
+{
+    if (!meters.prep)
+        return;
+    meters.prep->observe(Metrics::monoTime() - t0);
+    meters.held->set(traj.size());
+    // новые точки впервые попали в кадр; прогнозные точки из будущего и
+    // воспроизведение с модельным временем не в счёт
+    if (traj.lastTime() > shownLast)
+    {
+        shownLast = traj.lastTime();
+        const double lag = Metrics::ntpTime() - shownLast.doub();
+        if (lag >= 0. && lag < e2eMax)
+            meters.e2e->observe(lag);
+    }
+}
+
+DataPoint TrajStore::findByTime(xNtpTime t)
+{
+    DataPoint ret;
+    LeftRight<TrajBuffer>::Reader reader(trajDraw);
+    reader.get().interpolate(t, ret, &findCursor);
+    return ret;
+}
+
+int TrajStore::residuals(ResidualEngine &eng, const ResidualEngine::Batch &meas,
+                         ResidualEngine::Columns &out)
+{
+    LeftRight<TrajBuffer>::Reader reader(trajDraw);
+    return eng.compute(reader.get(), meas, out);
+}
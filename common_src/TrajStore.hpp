@@ -0,0 +1,168 @@
+#ifndef _TRAJSTORE_HPP_
+#define _TRAJSTORE_HPP_
+
+#include "VecMath.hpp"
+#include "xNtpTime.hpp"
+#include "TrajBuffer.hpp"
+#include "TrajVertexCache.hpp"
+#include "TrajLod.hpp"
+#include "ResidualEngine.hpp"
+#include "MeasPointBatch.hpp"
+#include "LeftRight.hpp"
+#include "FeedLog.hpp"
+#include "Metrics.hpp"
+
+class TrajClock;
+
+//! Диапазоны запроса точек траектории из БД, пустой диапазон - нули
+struct DbFetchRange
+{
+    // всё окно или его правая часть:
+    // Time>rLeft AND Time<rRight AND (ID>rId OR Time>rLast)
+    unsigned long long rLeft, rRight, rLast;
+    int rId;
+    // левая часть окна: Time>lLeft AND Time<lRight
+    unsigned long long lLeft, lRight;
+
+    DbFetchRange(void) {setEmpty();}
+    void setEmpty(void) {rLeft = rRight = rLast = lLeft = lRight = 0; rId = -1;}
+};
+
+/*! \class TrajStore
+ *  \brief Points of one trajectory around the model time.
+ *
+ *  Keeps the storage window of points (GenTraj::storeWindow), updates it
+ *  from DB rows or from decoded shm batches, publishes it for lock-free
+ *  reading and prepares the per-frame line and current position. Knows
+ *  nothing about Stellarium: the time comes from a TrajClock, the parameters
+ *  are references to the owner's settings.
+ */
+class TrajStore
+{
+    TrajStore(const TrajStore&);
+    const TrajStore& operator=(const TrajStore&);
+
+public:
+    //! результат подготовки кадра
+    struct Frame
+    {
+        const Vec3d *line;  // вершины линии в окне отрисовки
+        int lineSize;
+        Vec3d extr[2];      // отрезок экстраполяции антенны
+        bool drawExtr;
+        Vec3d pos;          // текущее положение
+        double range;       // текущая дальность
+    };
+
+    //! декодирование n = out.size записей из in в участок буфера
+    typedef void (*Decoder)(const void *in, const TrajBuffer::Span &out);
+
+    //! метрики одного источника, NULL - не собираются
+    struct Meters
+    {
+        Metrics::Counter *shmPoints, *dbPoints, *wait;
+        Metrics::Histogram *shmBatch, *dbRows, *prep, *e2e;
+        Metrics::Gauge *held;
+
+        Meters(void);
+    };
+
+    /* channel - тип траектории в БД и номер канала в feedLog,
+     * timeWindow - полуширина окна отрисовки [с],
+     * shmMaxPoints - предел числа точек из разделяемой памяти (0 - нет)
+     */
+    TrajStore(int channel, const TrajClock &clock, const unsigned &timeWindow,
+              const int &shmMaxPoints, FeedLog *const &feedLog);
+
+    /* Регистрация метрик с меткой source="<source>": поступление точек,
+     * размеры обновлений, число точек, время подготовки кадра, ожидание
+     * читателей и задержка от метки измерения до первого кадра с ним.
+     * Без вызова метрики не собираются.
+     */
+    void setMetrics(Metrics &m, const std::string &source);
+    //! метрики источника source в m, повторный вызов возвращает те же
+    static Meters registerMeters(Metrics &m, const std::string &source);
+
+    //! окно хранимых точек для момента stelT
+    static void storeWindow(const xNtpTime &stelT, unsigned timeWindow,
+                            xNtpTime &l_time, xNtpTime &r_time);
+
+    /* Обновление из БД: beginUpdate() заполняет диапазоны запроса (false -
+     * обновление не нужно), appendRow() принимает строки результата,
+     * finishUpdate() публикует обновлённую траекторию.
+     */
+    bool beginUpdate(DbFetchRange &req);
+    void appendRow(bool prepend, unsigned long long t, double az, double el,
+                   double dist, int id);
+    void finishUpdate(void);
+    //! the same update from a FeedLog::DbRows record
+    void replayUpdate(const FeedLog::DbWindow &w, const FeedLog::DbRow *rows,
+                      int n);
+
+    /* Добавление n записей из разделяемой памяти: декодирование на месте
+     * в конец резервного экземпляра и публикация. Хранится только окно по
+     * времени и не более shmMaxPoints точек, вытесненные точки учитываются
+     * в evicted() и overflow().
+     */
+    void appendShm(Decoder decode, const void *data, int n, size_t recSize);
+    // вытеснение устаревших точек, когда новых нет
+    void trim(void);
+    // очистка отрисовываемой траектории и буфера обновления
+    void clear(void);
+
+    /* Подготовка кадра в окне timeWindow: линия с допустимой угловой
+     * погрешностью tol [рад] (0 - без упрощения), положение в текущий
+     * момент, при extrapolate за последней точкой - по экстраполяции на
+     * extrTime [с]. false - точек нет.
+     */
+    bool prepare(double tol, bool extrapolate, double extrTime, Frame &out);
+    // точки моложе fadeWindow [с] с прозрачностью по возрасту
+    bool preparePoints(double fadeWindow, const Vec3f &rgb,
+                       MeasPointBatch &out);
+
+    DataPoint findByTime(xNtpTime t);
+    // невязки измерений относительно траектории за один проход
+    int residuals(ResidualEngine &eng, const ResidualEngine::Batch &meas,
+                  ResidualEngine::Columns &out);
+
+    //! отрисовываемая траектория, чтение через LeftRight::Reader
+    LeftRight<TrajBuffer>& draw(void) {return trajDraw;}
+    void requestUpdate(void) {updReq = true;}
+    unsigned long long evicted(void) const {return evictedPoints;}
+    unsigned long long overflow(void) const {return overflowPoints;}
+
+private:
+    const int channel;
+    const TrajClock &clock;
+    const unsigned &timeWindow;
+    const int &shmMaxPoints;
+    FeedLog *const &feedLog;
+
+    bool updReq;
+    // отрисовываемая траектория: чтение без блокировок, запись в потоках
+    // обновления из БД и разделяемой памяти
+    LeftRight<TrajBuffer> trajDraw;
+    TrajBuffer trajUpd;
+    int lastIdUpd;
+    // курсоры поиска по времени в trajDraw (отрисовка и findByTime)
+    int drawCursor, findCursor;
+    // вершины отрисовываемой части trajDraw, сохраняются между кадрами
+    TrajVertexCache lineCache;
+    // упрощённые уровни линии для мелкого масштаба
+    TrajLod lineLod;
+    // вытеснено точек: по окну времени и по ограничению числа точек
+    unsigned long long evictedPoints, overflowPoints;
+    // окно и строки текущего обновления для feedLog
+    FeedLog::DbWindow recWindow;
+    std::vector<FeedLog::DbRow> recRows;
+    Meters meters;
+    int updRows;                // строк в текущем обновлении из БД
+    unsigned long long waitSeen;    // учтённое время ожидания читателей, нс
+    xNtpTime shownLast;         // последняя точка, попавшая в кадр
+
+    void endAppend(TrajBuffer &standby, int n);
+    void endWrite(void);
+    void frameDone(const TrajBuffer &traj, double t0);
+};
+
+#endif // _TRAJSTORE_HPP_
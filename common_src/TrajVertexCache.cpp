@@ -0,0 +1,61 @@
+#include "TrajVertexCache.hpp"
+
+TrajVertexCache::TrajVertexCache()
+  : offset(0)
+  , stamp(0)
+  , seqFrom(0)
+  , seqTo(0)
+{
+}
+
+void TrajVertexCache::invalidate(void)
+{
+    verts.clear();
+    offset = 0;
+    stamp = 0;
+    seqFrom = seqTo = 0;
+}
+
+void TrajVertexCache::update(const TrajBuffer &traj, int from, int to)
+{
+    const int64_t nf = traj.seq(from), nt = traj.seq(to);
+    if (stamp != traj.stamp() || nf < seqFrom || nf > seqTo || nt < seqFrom)
+    {
+        rebuild(traj, from, to);
+        return;
+    }
+
+    // устаревшие точки слева
+    offset += (int)(nf - seqFrom);
+    seqFrom = nf;
+    // точки справа
+    if (nt < seqTo)
+    {
+        verts.resize(verts.size() - (size_t)(seqTo - nt));
+    }
+    else
+    {
+        for (int i = traj.indexOf(seqTo); i < to; ++i)
+            verts.push_back(traj.vec(i));
+    }
+    seqTo = nt;
+
+    // сжатие, когда удалённая часть превысила половину массива
+    if (offset > 1024 && offset > size())
+    {
+        verts.erase(verts.begin(), verts.begin() + offset);
+        offset = 0;
+    }
+}
+
+void TrajVertexCache::rebuild(const TrajBuffer &traj, int from, int to)
+{
+    verts.clear();
+    verts.reserve(to - from + 1);
+    for (int i = from; i < to; ++i)
+        verts.push_back(traj.vec(i));
+    offset = 0;
+    stamp = traj.stamp();
+    seqFrom = traj.seq(from);
+    seqTo = traj.seq(to);
+}
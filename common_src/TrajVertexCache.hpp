@@ -0,0 +1,34 @@
+#ifndef _TRAJVERTEXCACHE_HPP_
+#define _TRAJVERTEXCACHE_HPP_
+
+#include "TrajBuffer.hpp"
+
+/*! \class TrajVertexCache
+ *  \brief Retained vertex array of the drawn part of a trajectory.
+ *
+ *  Keeps vertices of points [from, to) of a TrajBuffer between frames.
+ *  While the buffer only grows and shrinks at its ends, update() appends
+ *  the new points and drops the expired ones; the array is rebuilt only
+ *  when the buffer stamp changes.
+ */
+class TrajVertexCache
+{
+public:
+    TrajVertexCache();
+
+    void update(const TrajBuffer &traj, int from, int to);
+    void invalidate(void);
+    const Vec3d* data(void) const {return verts.empty()? 0: &verts[offset];}
+    int size(void) const {return (int)verts.size() - offset;}
+    bool isEmpty(void) const {return !size();}
+
+private:
+    std::vector<Vec3d> verts;
+    int offset;         // first valid vertex in verts
+    uint64_t stamp;     // stamp of the cached TrajBuffer
+    int64_t seqFrom, seqTo; // cached range of point numbers
+
+    void rebuild(const TrajBuffer &traj, int from, int to);
+};
+
+#endif // _TRAJVERTEXCACHE_HPP_
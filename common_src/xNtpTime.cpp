@@ -11,15 +11,6 @@ xNtpTime::xNtpTime(const double &t)
     time = ((uint64_t)tmp_sec << 32) | (uint64_t)(tmp_frac * 4294967296.);
 }
 
-inline void xNtpTime::ntpt(ntptime_t *dst) const
-{
-    if (dst)
-    {
-        dst->psec = psec();
-        dst->sec = sec();
-    }
-}
-
 bool operator<(const xNtpTime& lhs, const xNtpTime& rhs)
 {
     return lhs.ext() < rhs.ext();
@@ -57,6 +57,15 @@ inline void xNtpTime::psec(uint32_t *dst) const
         *dst = (uint32_t)(time & 0xffffffff);
 }
 
+inline void xNtpTime::ntpt(ntptime_t *dst) const
+{
+    if (dst)
+    {
+        dst->psec = psec();
+        dst->sec = sec();
+    }
+}
+
 inline double xNtpTime::doub(void) const
 {
     return (double)sec() + (double)psec()*2.32830643654e-10;
@@ -2,9 +2,9 @@
 #define _ANTTRAJ_HPP_
 
 #include "GenTraj.hpp"
-#include <shmci/shmsbuf.h>
+#include "ShmIngest.hpp"
 
-class AntTraj : public GenTraj
+class AntTraj : public GenTraj, public ShmIngest::Source
 {
 public:
     AntTraj(QString id, QString texPath, int typ, SatTrajMgr& mgr, const QColorP& c);
@@ -13,21 +13,25 @@ public:
     virtual QString getType(void) const {return "AntTraj";}
     virtual void draw(SatTrajMgr* mgr, StelProjectorP prj, StelPainter& painter);
     virtual void baseUpdate(void);
+    virtual bool useDb(void);
 
 private:
-    pthread_t shmUpdThread;
-    ShmSBuf shmCont;
+    ShmIngest *shmIngest;   // не NULL, пока точки поступают из ShmIngest
 
-    void* shmRoutine(void);
-    void shmRoutCleanup(void);
-    void deinitShmThread(void);
-    void initShmThread(void);
+    void attachShm(ShmIngest *ingest);
+    void detachShm(void);
+
+    // ShmIngest::Source, вызываются в потоке ShmIngest
+    virtual const char* shmName(void) const {return "AntTraj";}
+    virtual int shmOpen(ShmSBuf &cont);
+    virtual int shmRecordSize(void) const;
+    virtual int shmCapacity(void) const;
+    virtual void shmConsume(const void *data, int n);
+    virtual void shmIdle(void);
+    virtual void shmFailed(void);
 
     // Percentage of FOV occupied by beam, when change to circle from texture
     static const float pointerChangePerc;
-
-    static void* callShmRoutine(void *arg) {return ((AntTraj*)arg)->shmRoutine();}
-    static void callShmCleanup(void *arg) {((AntTraj*)arg)->shmRoutCleanup();}
 };
 
 #endif // _ANTTRAJ_HPP_
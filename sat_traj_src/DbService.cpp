@@ -0,0 +1,364 @@
+#include "DbService.hpp"
+#include "SatTrajMgr.hpp"
+#include "Trace.hpp"
+
+#include <QtCore/QDebug>
+#include <stdexcept>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <vu_tools/vu_tools.h>
+#include <coord_conv/CoordConv.h>
+
+DbService::Snapshot::Snapshot(void)
+  : dbUp(false)
+  , done(0)
+  , adjValid(false)
+  , azAdj(0)
+  , zaAdj(0)
+  , antValid(false)
+  , mode(0)
+  , curAz(0)
+  , curZa(0)
+  , newAz(0)
+  , newZa(0)
+  , secValid(false)
+  , secState("N/A")
+  , secTarget("N/A")
+  , ntpEnabled(-1)
+{
+}
+
+DbService::DbService(SatTrajMgr *p)
+  : mgr(p)
+  , connected(false)
+  , wantConnected(false)
+  , thread(0)
+  , lastNum(0)
+  , stopReq(false)
+  , back(0)
+  , front(2)
+  , middle(1)
+{
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cv, NULL);
+}
+
+DbService::~DbService()
+{
+    stop();
+    pthread_cond_destroy(&cv);
+    pthread_mutex_destroy(&lock);
+}
+
+bool DbService::start(void)
+{
+    if (thread)
+        return true;
+    stopReq = false;
+    if (pthread_create(&thread, NULL, callRoutine, this))
+    {
+        qWarning() << "DbService pthread_create() " << strerror(errno);
+        thread = 0;
+        return false;
+    }
+    return true;
+}
+
+void DbService::stop(void)
+{
+    if (!thread)
+        return;
+    pthread_mutex_lock(&lock);
+    stopReq = true;
+    pthread_cond_signal(&cv);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+    thread = 0;
+}
+
+unsigned int DbService::post(RequestType type, int a, double x, double y)
+{
+    pthread_mutex_lock(&lock);
+    const unsigned int num = ++lastNum;
+    if (type == Connect || type == Disconnect)
+    {
+        wantConnected = (type == Connect);
+    }
+    else
+    {
+        // запрос того же типа, ещё стоящий в очереди, заменяется новым в
+        // конце очереди: номера выполняемых запросов только растут, в
+        // очереди не больше одного запроса каждого типа
+        std::deque<Request>::iterator it = queue.begin();
+        for (; it != queue.end(); ++it)
+            if (it->type == type ||
+                ((it->type == SetGoto || it->type == ClearGoto) &&
+                 (type == SetGoto || type == ClearGoto)))
+                break;
+        if (it != queue.end())
+            queue.erase(it);
+        Request req = {type, a, x, y, num};
+        queue.push_back(req);
+    }
+    pthread_cond_signal(&cv);
+    pthread_mutex_unlock(&lock);
+    return num;
+}
+
+const DbService::Snapshot& DbService::snapshot(void)
+{
+    if ((int)middle & dirtyBit)
+        front = middle.fetchAndStoreOrdered(front) & ~dirtyBit;
+    return buf[front];
+}
+
+void DbService::publish(void)
+{
+    buf[back] = work;
+    back = middle.fetchAndStoreOrdered(back | dirtyBit) & ~dirtyBit;
+}
+
+void* DbService::routine(void)
+{
+    SATTRAJ_TRACE_THREAD("db_service");
+    const int retryPeriod = 2; // sec
+    mysql_thread_init();
+    while (true)
+    {
+        pthread_mutex_lock(&lock);
+        while (!stopReq && queue.empty() && wantConnected == connected)
+            pthread_cond_wait(&cv, &lock);
+        if (stopReq)
+        {
+            pthread_mutex_unlock(&lock);
+            break;
+        }
+        const bool want = wantConnected;
+        Request req = {Connect, 0, 0., 0., 0};
+        if (!queue.empty() && (connected || !want))
+        {
+            req = queue.front();
+            queue.pop_front();
+        }
+        pthread_mutex_unlock(&lock);
+
+        if (!want)
+        {   // без соединения запросы отбрасываются
+            dropConnection();
+        }
+        else if (!connected && !ensureConnected())
+        {
+            publish();
+            struct timeval now;
+            struct timespec to;
+            gettimeofday(&now, NULL);
+            to.tv_sec = now.tv_sec + retryPeriod;
+            to.tv_nsec = now.tv_usec*1000;
+            pthread_mutex_lock(&lock);
+            if (!stopReq)
+                pthread_cond_timedwait(&cv, &lock, &to);
+            pthread_mutex_unlock(&lock);
+            continue;
+        }
+        else if (req.num)
+        {
+            try
+            {
+                process(req);
+            }
+            catch (std::runtime_error &e)
+            {
+                qWarning() << "DbService error: " << e.what();
+                dropConnection();
+            }
+        }
+        if (req.num)
+            work.done = req.num;
+        publish();
+    }
+    dropConnection();
+    mysql_thread_end();
+    return NULL;
+}
+
+bool DbService::ensureConnected(void)
+{
+    connected = mgr->initMysql(mysql);
+    work.dbUp = connected;
+    return connected;
+}
+
+void DbService::dropConnection(void)
+{
+    if (connected)
+        mysql_close(&mysql);
+    connected = false;
+    work.dbUp = false;
+    work.adjValid = false;
+    work.antValid = false;
+    work.secValid = false;
+    work.ntpEnabled = -1;
+}
+
+void DbService::query(const char *q)
+{
+    if (mysql_query(&mysql, q))
+    {
+        char buf[1024];
+        snprintf(buf, 1024, "[%s:%d] Error: can't send query to server:\n\t",
+                 _FILE_, __LINE__);
+        std::string err(buf);
+        err += mysql_error(&mysql);
+        throw std::runtime_error(err);
+    }
+}
+
+MYSQL_RES* DbService::select(const char *q)
+{
+    query(q);
+    MYSQL_RES *pRes = mysql_store_result(&mysql);
+    if (!pRes)
+    {
+        char buf[1024];
+        snprintf(buf, 1024, "[%s:%d] Error: can't get query result:\n\t",
+                 _FILE_, __LINE__);
+        std::string err(buf);
+        err += mysql_error(&mysql);
+        throw std::runtime_error(err);
+    }
+    return pRes;
+}
+
+void DbService::readParams(const char *table, const char *names[], int vals[],
+                           int n)
+{
+    std::string q("SELECT name,val FROM ");
+    q += table;
+    q += " WHERE name IN (";
+    for (int i = 0; i < n; ++i)
+    {
+        q += i? ",'": "'";
+        q += names[i];
+        q += "'";
+    }
+    q += ")";
+    MYSQL_RES *pRes = select(q.c_str());
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(pRes)))
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            if (row[0] && row[1] && !strcmp(row[0], names[i]))
+            {
+                vals[i] = atoi(row[1]);
+                break;
+            }
+        }
+    }
+    mysql_free_result(pRes);
+}
+
+void DbService::process(const Request &req)
+{
+    char buf[256];
+    switch (req.type)
+    {
+        case ReadAdj:
+        {
+            const char *names[] = {"Az_adj", "Za_adj"};
+            int vals[] = {work.azAdj, work.zaAdj};
+            readParams("adrive_params", names, vals, 2);
+            work.azAdj = vals[0];
+            work.zaAdj = vals[1];
+            work.adjValid = true;
+            break;
+        }
+        case ReadAntenna:
+        {
+            const char *names[] = {"Mode", "cur_Az", "cur_Za", "new_Az",
+                                   "new_Za"};
+            int vals[] = {work.mode, work.curAz, work.curZa, work.newAz,
+                          work.newZa};
+            readParams("adrive_params", names, vals, 5);
+            work.mode = vals[0];
+            work.curAz = vals[1];
+            work.curZa = vals[2];
+            work.newAz = vals[3];
+            work.newZa = vals[4];
+            work.antValid = true;
+            break;
+        }
+        case ReadSecProc:
+        {
+            MYSQL_RES *pRes = select("SELECT val FROM sec_processing_params "
+                                     "WHERE name='Status' OR name='Target' "
+                                     "ORDER BY ID ASC");
+            MYSQL_ROW row;
+            row = mysql_fetch_row(pRes);
+            work.secState.assign(row && row[0]? row[0]: "MYSQL query error");
+            row = row? mysql_fetch_row(pRes): NULL;
+            work.secTarget.assign(row && row[0]? row[0]: "MYSQL query error");
+            mysql_free_result(pRes);
+            work.secValid = true;
+            break;
+        }
+        case ReadNtp:
+        {
+            MYSQL_RES *pRes = select("SELECT val FROM ntptimed_params WHERE "
+                                     "name='Enabled'");
+            MYSQL_ROW row = mysql_fetch_row(pRes);
+            work.ntpEnabled = (row && row[0])? atoi(row[0]): -1;
+            mysql_free_result(pRes);
+            break;
+        }
+        case WriteAzAdj:
+            snprintf(buf, 256,
+                     "UPDATE adrive_params SET val='%d' WHERE name='Az_adj'",
+                     req.a);
+            query(buf);
+            work.azAdj = req.a;
+            break;
+        case WriteZaAdj:
+            snprintf(buf, 256,
+                     "UPDATE adrive_params SET val='%d' WHERE name='Za_adj'",
+                     req.a);
+            query(buf);
+            work.zaAdj = req.a;
+            break;
+        case SetGoto:
+        {
+            // Перевод в СК антенны
+            const char *names[] = {"cur_Az", "cur_Za"};
+            int vals[] = {0, 0};
+            readParams("adrive_params", names, vals, 2);
+            int_point ant, ant_cur = {vals[0], vals[1]};
+            double_point rls = {req.x, req.y};
+            ant = radar2antenna(rls, ant_cur);
+            qDebug()<<"Cur point ANT:"<<ant_cur.first<<ant_cur.second;
+            qDebug()<<"New point ANT:"<<ant.first<<ant.second;
+            snprintf(buf, 256,
+                     "UPDATE adrive_params SET val='%d' WHERE name='new_Az'",
+                     ant.first);
+            query(buf);
+            snprintf(buf, 256,
+                     "UPDATE adrive_params SET val='%d' WHERE name='new_Za'",
+                     ant.second);
+            query(buf);
+            query("UPDATE adrive_params SET val='2' WHERE name='Mode'");
+            work.curAz = ant_cur.first;
+            work.curZa = ant_cur.second;
+            work.newAz = ant.first;
+            work.newZa = ant.second;
+            work.mode = 2;
+            work.antValid = true;
+            break;
+        }
+        case ClearGoto:
+            query("UPDATE adrive_params SET val='1' WHERE name='Mode'");
+            work.mode = 1;
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef _DBSERVICE_HPP_
+#define _DBSERVICE_HPP_
+
+#include <QtCore/QAtomicInt>
+#include <mysql/mysql.h>
+#include <pthread.h>
+#include <deque>
+#include <string>
+
+class SatTrajMgr;
+
+/*! \class DbService
+ *  \brief Asynchronous access to the antenna and service tables of the DB.
+ *
+ *  Owns a separate MYSQL connection and a worker thread. The frame code
+ *  posts requests with post() and reads results with snapshot(), neither
+ *  of them waits for the server. The worker publishes results through a
+ *  triple buffer; snapshot() must be called from one thread only (the
+ *  Stellarium main thread). DB errors stay in the worker: they are
+ *  reported with qWarning and make the snapshot show dbUp == false until
+ *  the connection is restored.
+ */
+class DbService
+{
+    DbService(const DbService&);
+    const DbService& operator=(const DbService&);
+
+public:
+    enum RequestType
+    {
+        Connect,        // подключиться и поддерживать соединение
+        Disconnect,
+        ReadAdj,        // поправки Az_adj, Za_adj
+        ReadAntenna,    // Mode, cur_Az, cur_Za, new_Az, new_Za
+        ReadSecProc,    // состояние sec_processing
+        ReadNtp,        // состояние ntptimed
+        WriteAzAdj,     // a - поправка по азимуту
+        WriteZaAdj,     // a - поправка по углу места
+        SetGoto,        // x, y - азимут и угол места точки в СК РЛС
+        ClearGoto
+    };
+
+    struct Snapshot
+    {
+        Snapshot(void);
+
+        bool dbUp;
+        unsigned int done;  // номер последнего выполненного запроса
+        bool adjValid;
+        int azAdj, zaAdj;
+        bool antValid;
+        int mode, curAz, curZa, newAz, newZa;
+        bool secValid;
+        std::string secState, secTarget;
+        int ntpEnabled;     // -1 - неизвестно
+    };
+
+    explicit DbService(SatTrajMgr *p);
+    ~DbService();
+
+    bool start(void);
+    void stop(void);
+    //! queue request, returns its number to compare with Snapshot::done
+    unsigned int post(RequestType type, int a = 0, double x = 0.,
+                      double y = 0.);
+    //! latest published state
+    const Snapshot& snapshot(void);
+
+private:
+    struct Request
+    {
+        RequestType type;
+        int a;
+        double x, y;
+        unsigned int num;
+    };
+
+    SatTrajMgr *const mgr;
+    MYSQL mysql;
+    bool connected;
+    bool wantConnected;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+    std::deque<Request> queue;
+    unsigned int lastNum;
+    bool stopReq;
+
+    // тройной буфер: work - изменяется потоком, buf[back] - заполняется
+    // при публикации, buf[front] - читается, middle - обмен между ними
+    Snapshot work;
+    Snapshot buf[3];
+    int back, front;
+    QAtomicInt middle;
+
+    static const int dirtyBit = 4;
+
+    void* routine(void);
+    void process(const Request &req);
+    void publish(void);
+    bool ensureConnected(void);
+    void dropConnection(void);
+    void query(const char *q);
+    MYSQL_RES* select(const char *q);
+    void readParams(const char *table, const char *names[], int vals[], int n);
+
+    static void* callRoutine(void *arg) {return ((DbService*)arg)->routine();}
+};
+
+#endif // _DBSERVICE_HPP_
@@ -0,0 +1,172 @@
+#include "FeedReplay.hpp"
+#include "SatTrajMgr.hpp"
+#include "Trace.hpp"
+
+#include <QtCore/QDebug>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+FeedReplay::FeedReplay(SatTrajMgr *m, const std::string &path, double sp,
+                       double start)
+  : reader(path)
+  , mgr(m)
+  , speed(sp)
+  , startSec(start)
+  , thread(0)
+  , stopReq(false)
+  , finished(false)
+  , hasStatus(false)
+  , hasClock(false)
+  , mono0(0)
+  , wall0(0.)
+  , lastMono(0)
+  , lastStel(0)
+{
+    memset(&lastStatus, 0, sizeof lastStatus);
+    pthread_mutex_init(&lock, NULL);
+    // сроки отсчитываются по монотонным часам
+    pthread_condattr_t cvAttr;
+    pthread_condattr_init(&cvAttr);
+    pthread_condattr_setclock(&cvAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cv, &cvAttr);
+    pthread_condattr_destroy(&cvAttr);
+}
+
+FeedReplay::~FeedReplay()
+{
+    stop();
+    pthread_cond_destroy(&cv);
+    pthread_mutex_destroy(&lock);
+}
+
+bool FeedReplay::start(void)
+{
+    if (thread)
+        return true;
+    stopReq = false;
+    if (pthread_create(&thread, NULL, callRoutine, this))
+    {
+        qWarning() << "FeedReplay pthread_create() " << strerror(errno);
+        thread = 0;
+        return false;
+    }
+    return true;
+}
+
+void FeedReplay::stop(void)
+{
+    if (!thread)
+        return;
+    pthread_mutex_lock(&lock);
+    stopReq = true;
+    pthread_cond_broadcast(&cv);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+    thread = 0;
+}
+
+bool FeedReplay::status(FeedLog::StatusRec &st) const
+{
+    pthread_mutex_lock(&lock);
+    const bool ret = hasStatus;
+    st = lastStatus;
+    pthread_mutex_unlock(&lock);
+    return ret;
+}
+
+bool FeedReplay::clock(xNtpTime &stelT) const
+{
+    pthread_mutex_lock(&lock);
+    if (!hasClock)
+    {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+    // между записями время идёт со скоростью воспроизведения
+    double dt = 0.;
+    if (speed > 0.)
+        dt = (monoSec() - wall0)*speed - (lastMono - mono0)*1e-9;
+    stelT = xNtpTime(lastStel);
+    pthread_mutex_unlock(&lock);
+    if (dt > 0.)
+        stelT += xNtpTime(dt);
+    return true;
+}
+
+bool FeedReplay::isFinished(void) const
+{
+    pthread_mutex_lock(&lock);
+    const bool ret = finished;
+    pthread_mutex_unlock(&lock);
+    return ret;
+}
+
+double FeedReplay::monoSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+bool FeedReplay::waitFor(uint64_t mono)
+{
+    pthread_mutex_lock(&lock);
+    if (speed > 0.)
+    {
+        const double wakeUp = wall0 + (mono - mono0)*1e-9/speed;
+        struct timespec to;
+        to.tv_sec = (time_t)wakeUp;
+        to.tv_nsec = (long)((wakeUp - to.tv_sec)*1e9);
+        while (!stopReq && monoSec() < wakeUp)
+            pthread_cond_timedwait(&cv, &lock, &to);
+    }
+    const bool ret = !stopReq;
+    pthread_mutex_unlock(&lock);
+    return ret;
+}
+
+void* FeedReplay::routine(void)
+{
+    SATTRAJ_TRACE_THREAD("replay");
+    const FeedLog::RecHeader *h;
+    const void *data;
+    unsigned long long n = 0;
+
+    reader.seek(reader.firstMono() + (uint64_t)(startSec*1e9));
+    while (reader.next(h, data))
+    {
+        if (!n)
+        {
+            pthread_mutex_lock(&lock);
+            mono0 = h->mono;
+            wall0 = monoSec();
+            pthread_mutex_unlock(&lock);
+        }
+        else if (!waitFor(h->mono))
+        {
+            break;
+        }
+
+        pthread_mutex_lock(&lock);
+        lastMono = h->mono;
+        lastStel = h->stel;
+        hasClock = true;
+        if (h->type == FeedLog::Status && h->size == sizeof(lastStatus))
+        {
+            memcpy(&lastStatus, data, sizeof(lastStatus));
+            hasStatus = true;
+        }
+        pthread_mutex_unlock(&lock);
+        if (h->type != FeedLog::Status)
+            mgr->replayRecord(*h, data);
+        ++n;
+    }
+
+    pthread_mutex_lock(&lock);
+    finished = !stopReq;
+    pthread_mutex_unlock(&lock);
+    if (finished)
+        qDebug() << "FeedReplay: end of log," << n << "records";
+    return NULL;
+}
@@ -0,0 +1,65 @@
+#ifndef _FEEDREPLAY_HPP_
+#define _FEEDREPLAY_HPP_
+
+#include "FeedLog.hpp"
+#include "xNtpTime.hpp"
+#include <pthread.h>
+
+class SatTrajMgr;
+
+/*! \class FeedReplay
+ *  \brief Feeds a recorded FeedLog back into SatTrajMgr instead of the DB
+ *  and shared memory.
+ *
+ *  The worker thread dispatches records at the recorded monotonic pace
+ *  scaled by speed (speed <= 0 - without waiting). Trajectory records go
+ *  to SatTrajMgr::replayRecord(), status records are kept here for the
+ *  main thread. The replayed Stellarium time is the time of the last
+ *  dispatched record advanced by the replay clock.
+ */
+class FeedReplay
+{
+    FeedReplay(const FeedReplay&);
+    const FeedReplay& operator=(const FeedReplay&);
+
+public:
+    //! throws std::runtime_error if path is not a FeedLog
+    FeedReplay(SatTrajMgr *mgr, const std::string &path, double speed,
+               double startSec);
+    ~FeedReplay();
+
+    bool start(void);
+    void stop(void);
+
+    //! false until the first status record
+    bool status(FeedLog::StatusRec &st) const;
+    //! false until the first record
+    bool clock(xNtpTime &stelT) const;
+    bool isFinished(void) const;
+
+private:
+    FeedLogReader reader;
+    SatTrajMgr *const mgr;
+    const double speed;
+    const double startSec;
+    pthread_t thread;
+    mutable pthread_mutex_t lock;
+    pthread_cond_t cv;
+    bool stopReq;
+    bool finished;
+    bool hasStatus;
+    FeedLog::StatusRec lastStatus;
+    bool hasClock;
+    uint64_t mono0;     // время записи, соответствующее wall0
+    double wall0;       // монотонное время начала воспроизведения, с
+    uint64_t lastMono, lastStel;
+
+    void* routine(void);
+    //! wait until the record time, false on stop()
+    bool waitFor(uint64_t mono);
+
+    static double monoSec(void);
+    static void* callRoutine(void *arg) {return ((FeedReplay*)arg)->routine();}
+};
+
+#endif // _FEEDREPLAY_HPP_
@@ -3,7 +3,6 @@
 #include "StelApp.hpp"
 #include "StelCore.hpp"
 
-const float GenObject::wndRelSize = 4.f;
 const float GenObject::antennaCone = 4.f/60.f;
 const float GenObject::measurementPerc = 0.1f;
 
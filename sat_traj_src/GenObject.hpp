@@ -57,8 +57,6 @@ protected:
     bool visible;
     QColorP color;
 
-    // Prefetch time window size relative to draw window (>1)
-    static const float wndRelSize;
     // Beam width [deg]
     static const float antennaCone;
     // Size of measurement point relative to beam width
@@ -5,22 +5,13 @@
 #include "xNtpTime.hpp"
 #include "StelTextureTypes.hpp"
 #include "GenObject.hpp"
-#include <mysql/mysql.h>
-#include <pthread.h>
+#include "TrajStore.hpp"
+#include "TrajFetcher.hpp"
+#include <string>
 
 class SatTrajMgr;
 class StelPainter;
 
-struct DataPoint
-{
-    DataPoint(void): time((uint64_t)0) {}
-
-    xNtpTime time;
-    Vec3d vec;
-    double dist;
-};
-Q_DECLARE_TYPEINFO(DataPoint, Q_PRIMITIVE_TYPE);
-
 class GenTraj : public GenObject
 {
   public:
@@ -31,30 +22,53 @@ class GenTraj : public GenObject
     virtual void draw(SatTrajMgr* mgr, StelProjectorP prj, StelPainter& painter)=0;
     virtual QString getInfoString(const StelCore *core, const InfoStringGroup& flags) const;
     virtual void baseUpdate(void);
+    // false, если точки траектории сейчас поступают не из БД
+    virtual bool useDb(void) {return true;}
+    //! закрытие запросов к БД перед закрытием соединения
+    void closeDb(void) {fetcher.close();}
+    int getDbType(void) const {return type;}
+    //! draw() with the draw time recorded in the metrics
+    void drawTimed(SatTrajMgr* mgr, StelProjectorP prj, StelPainter& painter);
+    //! short source name for metrics labels and the HUD
+    static const char* sourceName(int type);
+    //! DB query latency histogram with the label query="<query>"
+    static Metrics::Histogram& queryHist(Metrics &m, const char *query);
 
-    DataPoint findByTime(xNtpTime t);
+    // обновление по частям для совместного запроса всех траекторий
+    bool beginUpdate(DbFetchRange &req) {return store.beginUpdate(req);}
+    void appendRow(bool prepend, unsigned long long t, double az, double el,
+                   double dist, int id)
+        {store.appendRow(prepend, t, az, el, dist, id);}
+    void finishUpdate(void) {store.finishUpdate();}
+    void replayUpdate(const FeedLog::DbWindow &w, const FeedLog::DbRow *rows,
+                      int n)
+        {store.replayUpdate(w, rows, n);}
+
+    DataPoint findByTime(xNtpTime t) {return store.findByTime(t);}
+    // невязки измерений относительно траектории за один проход
+    int residuals(ResidualEngine &eng, const ResidualEngine::Batch &meas,
+                  ResidualEngine::Columns &out)
+        {return store.residuals(eng, meas, out);}
 
   protected:
     void genDraw(SatTrajMgr* mgr, StelPainter& painter);
 
-    pthread_spinlock_t ptrChangeLock;
-    bool updReq;
+    // модуль-владелец, без GETSTELMODULE в потоках БД и разделяемой памяти
+    SatTrajMgr &owner;
     StelTextureSP hintTexture;
-    QList<DataPoint> trajDraw;
-    QList<DataPoint> trajUpd;
-    int lastIdDraw, lastIdUpd;
-
-    // удаление перекрывающихся по времени участков
-    void cleanupTraj(QList<DataPoint> &traj);
+    // точки траектории, обновление из БД и разделяемой памяти
+    TrajStore store;
+    // траектория получается из разделяемой памяти
+    bool liveFeed;
 
   private:
     int type; // используется при обращении к БД
-    MYSQL *mysql;
+    const std::string &tableName;
     const bool &antExtr;
     const double &antExtrTime;
-
-    void sendParseQuery(const char query[], const SatTrajMgr* mgr,
-                        bool prepend = false);
+    TrajFetcher fetcher;
+    Metrics::Histogram &drawHist;   // время отрисовки
+    Metrics::Histogram &dbHist;     // время отдельного запроса к БД
 };
 
 #endif /* _GENTRAJ_HPP_ */
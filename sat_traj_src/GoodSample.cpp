@@ -1,22 +1,16 @@
 #include "GoodSample.hpp"
-#include "StelApp.hpp"
-#include "StelTextureMgr.hpp"
-#include "StelPainter.hpp"
-#include "StelProjector.hpp"
 #include "SatTrajMgr.hpp"
-
-StelTextureSP GoodSample::hintTexture;
-xNtpTime GoodSample::drawTime;
+#include "StelProjector.hpp"
 
 GoodSample::GoodSample(QString id, const QColorP& c,
-    xNtpTime _t, const Vec3d &_pos, double _d, double dAz, double dEl)
+                       const GoodSampleStore::Sample &s)
   : GenObject(id, c)
-  , t(_t)
-  , deltaAz(dAz)
-  , deltaEl(dEl)
+  , t(s.t)
+  , deltaAz(s.dAz)
+  , deltaEl(s.dEl)
 {
-    XYZ = _pos;
-    curRange = _d;
+    XYZ = s.pos;
+    curRange = s.dist;
     initialized = true;
 }
 
@@ -24,36 +18,26 @@ GoodSample::~GoodSample()
 {
 }
 
-void GoodSample::draw(SatTrajMgr* mgr, StelProjectorP prj, StelPainter& painter)
+void GoodSample::draw(SatTrajMgr* mgr, StelProjectorP /*prj*/,
+                      StelPainter& /*painter*/)
 {
-    if (hintTexture.isNull() || !mgr->enableGoodSamples)
-        return;
-
-    xNtpTime l_time = drawTime - xNtpTime((u64)mgr->timeWindow << 32);
-    xNtpTime r_time = drawTime + xNtpTime((u64)mgr->timeWindow << 32);
-    if (t < l_time || t > r_time)
-    {
-        visible = false;
-        return;
-    }
-    else
-        visible = true;
+    // отсчёт рисуется хранилищем, здесь только признак видимости
+    xNtpTime stelT;
+    getStelTimeNTP(stelT);
+    xNtpTime l_time = stelT - xNtpTime((u64)mgr->timeWindow << 32);
+    xNtpTime r_time = stelT + xNtpTime((u64)mgr->timeWindow << 32);
+    visible = mgr->enableGoodSamples && t >= l_time && t <= r_time;
+}
 
-    float hintSize = antennaCone*measurementPerc*2.f/180.f*3.1416f*
-                     prj->getPixelPerRadAtCenter();
-    if (hintSize < 8.f)
-        hintSize = 8.f;
-    else if (hintSize > 32.f)
-        hintSize = 32.f;
-    painter.enableTexture2d(true);
-    painter.setColor(color->redF(), color->greenF(), color->blueF());
-    hintTexture->bind();
-    Vec3d xy;
-    if (prj->project(XYZ, xy))
-    {
-        painter.drawSprite2dMode(xy[0], xy[1], hintSize);
-    }
-    painter.enableTexture2d(false);
+float GoodSample::hintSize(StelProjectorP prj)
+{
+    float size = antennaCone*measurementPerc*2.f/180.f*3.1416f*
+                 prj->getPixelPerRadAtCenter();
+    if (size < 8.f)
+        size = 8.f;
+    else if (size > 32.f)
+        size = 32.f;
+    return size;
 }
 
 QString GoodSample::getInfoString(const StelCore* core,
@@ -2,14 +2,19 @@
 #define _GOODSAMPLE_HPP_
 
 #include "GenObject.hpp"
-#include "StelTextureTypes.hpp"
-#include "xNtpTime.hpp"
+#include "GoodSampleStore.hpp"
 
+/*! \class GoodSample
+ *  \brief StelObject proxy of a picked sample of GoodSampleStore.
+ *
+ *  Samples themselves are drawn by the store; the proxy only provides
+ *  the info string and tracks visibility for the selection pointer.
+ */
 class GoodSample : public GenObject
 {
 public:
-    GoodSample(QString id, const QColorP& c, xNtpTime _t,
-               const Vec3d &_pos, double _d, double dAz, double dEl);
+    GoodSample(QString id, const QColorP& c,
+               const GoodSampleStore::Sample &s);
     virtual ~GoodSample();
 
     virtual QString getType(void) const {return "GoodSample";}
@@ -17,10 +22,11 @@ public:
     virtual void draw(SatTrajMgr* mgr, StelProjectorP prj, StelPainter& painter);
     virtual void baseUpdate(void) {};
 
-    // используется для указания текущего модельного времени при отрисовке,
-    // чтобы не рассчитывать одно и то же время для каждой точки
-    static xNtpTime drawTime;
-    static StelTextureSP hintTexture;
+    //! Sprite radius [px] of samples at the projector scale
+    static float hintSize(StelProjectorP prj);
+    bool isSame(const GoodSampleStore::Sample &s) const
+        {return s.t == t && s.pos[0] == XYZ[0] && s.pos[1] == XYZ[1] &&
+                s.pos[2] == XYZ[2];}
 
 private:
     const xNtpTime t;     // время привязки отсчёта
@@ -0,0 +1,185 @@
+#include "GoodSampleStore.hpp"
+#include "StelPainter.hpp"
+#include "StelProjector.hpp"
+#include "StelTexture.hpp"
+#include <QtOpenGL/QtOpenGL>
+#include <algorithm>
+
+void GoodSampleStore::Columns::append(const Sample &s)
+{
+    const uint64_t t = s.t.ext();
+    if (time.empty() || t >= time.back())
+    {
+        time.push_back(t);
+        pos.push_back(s.pos);
+        dist.push_back(s.dist);
+        dAz.push_back(s.dAz);
+        dEl.push_back(s.dEl);
+        return;
+    }
+    // отсчёты приходят в порядке ID, время может немного нарушать порядок
+    const int i = std::upper_bound(time.begin(), time.end(), t) - time.begin();
+    time.insert(time.begin() + i, t);
+    pos.insert(pos.begin() + i, s.pos);
+    dist.insert(dist.begin() + i, s.dist);
+    dAz.insert(dAz.begin() + i, s.dAz);
+    dEl.insert(dEl.begin() + i, s.dEl);
+}
+
+void GoodSampleStore::Columns::append(const Columns &src)
+{
+    Sample s;
+    for (int i = 0; i < src.size(); ++i)
+    {
+        src.get(i, s);
+        append(s);
+    }
+}
+
+void GoodSampleStore::Columns::removeFirst(int n)
+{
+    if (n <= 0)
+        return;
+    n = std::min(n, size());
+    time.erase(time.begin(), time.begin() + n);
+    pos.erase(pos.begin(), pos.begin() + n);
+    dist.erase(dist.begin(), dist.begin() + n);
+    dAz.erase(dAz.begin(), dAz.begin() + n);
+    dEl.erase(dEl.begin(), dEl.begin() + n);
+}
+
+int GoodSampleStore::Columns::lowerBound(const xNtpTime &t) const
+{
+    return std::lower_bound(time.begin(), time.end(), t.ext()) - time.begin();
+}
+
+void GoodSampleStore::Columns::get(int i, Sample &s) const
+{
+    s.t = xNtpTime(time[i]);
+    s.pos = pos[i];
+    s.dist = dist[i];
+    s.dAz = dAz[i];
+    s.dEl = dEl[i];
+}
+
+void GoodSampleStore::Columns::clear(void)
+{
+    time.clear();
+    pos.clear();
+    dist.clear();
+    dAz.clear();
+    dEl.clear();
+}
+
+/* -------------------------------------------------------------------------- */
+
+void GoodSampleStore::update(Columns &c, const Columns &add,
+                             const xNtpTime &l_time)
+{
+    c.append(add);
+    c.removeFirst(c.lowerBound(l_time));
+    c.removeFirst(c.size() - maxSamples);
+}
+
+void GoodSampleStore::commit(const xNtpTime &l_time)
+{
+    const Columns &c = data.published();
+    // нечего публиковать и удалять
+    if (pending.isEmpty() &&
+        (c.isEmpty() || xNtpTime(c.time.front()) >= l_time))
+        return;
+    update(data.beginWrite(), pending, l_time);
+    update(data.publish(), pending, l_time);
+    data.endWrite();
+    pending.clear();
+}
+
+void GoodSampleStore::clear(void)
+{
+    data.beginWrite().clear();
+    data.publish().clear();
+    data.endWrite();
+    pending.clear();
+}
+
+int GoodSampleStore::size(void)
+{
+    LeftRight<Columns>::Reader reader(data);
+    return reader.get().size();
+}
+
+void GoodSampleStore::draw(const xNtpTime &l_time, const xNtpTime &r_time,
+                           StelProjectorP prj, StelPainter &painter,
+                           const QColor &c, float size)
+{
+    if (hintTexture.isNull())
+        return;
+
+    sprVerts.clear();
+    sprTex.clear();
+    {
+        LeftRight<Columns>::Reader reader(data);
+        const Columns &cols = reader.get();
+        const int from = cols.lowerBound(l_time);
+        const int to = std::max(from, cols.lowerBound(r_time + xNtpTime((u64)1)));
+        Vec3d xy;
+        for (int i = from; i < to; ++i)
+        {
+            if (!prj->project(cols.pos[i], xy))
+                continue;
+            const float x0 = xy[0] - size, x1 = xy[0] + size;
+            const float y0 = xy[1] - size, y1 = xy[1] + size;
+            sprVerts.push_back(Vec2f(x0, y0));
+            sprVerts.push_back(Vec2f(x1, y0));
+            sprVerts.push_back(Vec2f(x1, y1));
+            sprVerts.push_back(Vec2f(x0, y0));
+            sprVerts.push_back(Vec2f(x1, y1));
+            sprVerts.push_back(Vec2f(x0, y1));
+            sprTex.push_back(Vec2f(0.f, 0.f));
+            sprTex.push_back(Vec2f(1.f, 0.f));
+            sprTex.push_back(Vec2f(1.f, 1.f));
+            sprTex.push_back(Vec2f(0.f, 0.f));
+            sprTex.push_back(Vec2f(1.f, 1.f));
+            sprTex.push_back(Vec2f(0.f, 1.f));
+        }
+    }
+    if (sprVerts.empty())
+        return;
+
+    // все отсчёты одним вызовом, вершины уже в экранных координатах
+    painter.enableTexture2d(true);
+    painter.setColor(c.redF(), c.greenF(), c.blueF());
+    hintTexture->bind();
+    painter.setVertexPointer(2, GL_FLOAT, &sprVerts[0]);
+    painter.setTexCoordPointer(2, GL_FLOAT, &sprTex[0]);
+    painter.enableClientStates(true, true);
+    painter.drawFromArray(StelPainter::Triangles, (int)sprVerts.size(), 0,
+                          false);
+    painter.enableClientStates(false);
+    painter.enableTexture2d(false);
+}
+
+bool GoodSampleStore::nearest(const Vec3d &v, double cosLim,
+                              const xNtpTime &l_time, const xNtpTime &r_time,
+                              Sample &s)
+{
+    LeftRight<Columns>::Reader reader(data);
+    const Columns &cols = reader.get();
+    const int from = cols.lowerBound(l_time);
+    const int to = std::max(from, cols.lowerBound(r_time + xNtpTime((u64)1)));
+    int best = -1;
+    double bestCos = cosLim;
+    for (int i = from; i < to; ++i)
+    {
+        const double c = cols.pos[i].dot(v);
+        if (c >= bestCos)
+        {
+            bestCos = c;
+            best = i;
+        }
+    }
+    if (best < 0)
+        return false;
+    cols.get(best, s);
+    return true;
+}
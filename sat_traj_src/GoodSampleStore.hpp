@@ -0,0 +1,97 @@
+#ifndef _GOODSAMPLESTORE_HPP_
+#define _GOODSAMPLESTORE_HPP_
+
+#include "LeftRight.hpp"
+#include "StelProjectorType.hpp"
+#include "StelTextureTypes.hpp"
+#include "VecMath.hpp"
+#include "xNtpTime.hpp"
+#include <QColor>
+#include <vector>
+
+class StelPainter;
+
+/*! \class GoodSampleStore
+ *  \brief Time-ordered columnar storage of good samples.
+ *
+ *  Samples are kept as columns (time, position, range, dAz, dEl) sorted
+ *  by time, so the drawing window is found by binary search. The database
+ *  thread collects new samples with add() and makes them visible with
+ *  commit(), which also evicts samples older than the storage window.
+ *  The drawing thread reads the published columns without locks
+ *  (LeftRight) and draws all visible samples with one call; StelObject
+ *  proxies (GoodSample) are created only for a picked sample.
+ */
+class GoodSampleStore
+{
+    GoodSampleStore(const GoodSampleStore&);
+    const GoodSampleStore& operator=(const GoodSampleStore&);
+
+public:
+    struct Sample
+    {
+        xNtpTime t;
+        Vec3d pos;      // Alt/Az, единичный вектор
+        double dist;
+        double dAz;     // отклонение по азимуту от ЦУ [угл.мин]
+        double dEl;     // отклонение по углу места от ЦУ [угл.мин]
+    };
+
+    GoodSampleStore() {}
+
+    // поток БД
+    void add(const Sample &s) {pending.append(s);}
+    //! Publish added samples, drop samples older than l_time
+    void commit(const xNtpTime &l_time);
+    void clear(void);
+
+    // поток отрисовки
+    /*! Draw samples in [l_time, r_time] as sprites of radius size [px]
+     *  with a single drawFromArray call.
+     */
+    void draw(const xNtpTime &l_time, const xNtpTime &r_time,
+              StelProjectorP prj, StelPainter &painter, const QColor &c,
+              float size);
+    /*! Sample in [l_time, r_time] nearest to the direction v (Alt/Az)
+     *  within the angle with cosine cosLim.
+     *  \return false if there is no such sample
+     */
+    bool nearest(const Vec3d &v, double cosLim, const xNtpTime &l_time,
+                 const xNtpTime &r_time, Sample &s);
+    int size(void);
+
+    void setTexture(const StelTextureSP &tex) {hintTexture = tex;}
+
+    // ограничение объёма при редком обновлении окна
+    static const int maxSamples = 100000;
+
+private:
+    struct Columns
+    {
+        std::vector<uint64_t> time;
+        std::vector<Vec3d> pos;
+        std::vector<double> dist;
+        std::vector<double> dAz;
+        std::vector<double> dEl;
+
+        int size(void) const {return (int)time.size();}
+        bool isEmpty(void) const {return time.empty();}
+        void append(const Sample &s);
+        void append(const Columns &src);
+        void removeFirst(int n);
+        int lowerBound(const xNtpTime &t) const;
+        void get(int i, Sample &s) const;
+        void clear(void);
+    };
+
+    LeftRight<Columns> data;
+    Columns pending;            // добавленные, но не опубликованные
+    StelTextureSP hintTexture;
+    std::vector<Vec2f> sprVerts;    // два треугольника на отсчёт
+    std::vector<Vec2f> sprTex;
+
+    static void update(Columns &c, const Columns &add,
+                       const xNtpTime &l_time);
+};
+
+#endif // _GOODSAMPLESTORE_HPP_
@@ -2,9 +2,10 @@
 #define _MEASTRAJ_HPP_
 
 #include "GenTraj.hpp"
-#include <shmci/shmsbuf.h>
+#include "MeasPointBatch.hpp"
+#include "ShmIngest.hpp"
 
-class MeasTraj : public GenTraj
+class MeasTraj : public GenTraj, public ShmIngest::Source
 {
 public:
     MeasTraj(QString id, QString texPath, int typ, SatTrajMgr& mgr, const QColorP& c);
@@ -13,18 +14,23 @@ public:
     virtual QString getType(void) const {return "MeasTraj";}
     virtual void draw(SatTrajMgr* mgr, StelProjectorP prj, StelPainter& painter);
     virtual void baseUpdate(void);
+    virtual bool useDb(void);
 
 private:
-    pthread_t shmUpdThread;
-    ShmSBuf shmCont;
+    ShmIngest *shmIngest;   // не NULL, пока точки поступают из ShmIngest
+    MeasPointBatch pointBatch;
 
-    void* shmRoutine(void);
-    void shmRoutCleanup(void);
-    void deinitShmThread(void);
-    void initShmThread(void);
+    void attachShm(ShmIngest *ingest);
+    void detachShm(void);
 
-    static void* callShmRoutine(void *arg) {return ((MeasTraj*)arg)->shmRoutine();}
-    static void callShmCleanup(void *arg) {((MeasTraj*)arg)->shmRoutCleanup();}
+    // ShmIngest::Source, вызываются в потоке ShmIngest
+    virtual const char* shmName(void) const {return "MeasTraj";}
+    virtual int shmOpen(ShmSBuf &cont);
+    virtual int shmRecordSize(void) const;
+    virtual int shmCapacity(void) const;
+    virtual void shmConsume(const void *data, int n);
+    virtual void shmIdle(void);
+    virtual void shmFailed(void);
 };
 
 #endif // _MEASTRAJ_HPP_
@@ -15,12 +15,16 @@
 #include "MeasTraj.hpp"
 #include "AntTraj.hpp"
 #include "GoodSample.hpp"
+#include "AzElConv.hpp"
+#include "FeedReplay.hpp"
+#include "Trace.hpp"
 
 #include <QtOpenGL/QtOpenGL>
 #include <QtCore/QTimer>
 #include <vu_tools/vu_tools.h>
 #include <coord_conv/CoordConv.h>
-#include <locale.h>
+#include <errno.h>
+#include <string.h>
 
 StelModule* SatTrajMgrStelPluginInterface::getStelModule() const
 {
@@ -53,11 +57,20 @@ SatTrajMgr::SatTrajMgr()
     , antExtr(false)
     , antExtrK(1.2)
     , antExtrTime(baseUpdTime*antExtrK)
-    , changeDecimal(false)
     , gWidth(450)
     , gHeight(64)
     , enableGoodSamples(false)
     , enableShm(false)
+    , shmMaxPoints(200000)
+    , lodPixelTol(0.5)
+    , combinedFetch(true)
+    , goodSamplesStride(200)
+    , residualRef(1)
+    , feedReplaySpeed(1.)
+    , feedReplayStart(0.)
+    , feedLog(NULL)
+    , metricsHud(false)
+    , metricsPeriod(10.)
     , pMeasColor(new QColor)
     , pTdColor(new QColor)
     , pRefColor(new QColor)
@@ -80,18 +93,33 @@ SatTrajMgr::SatTrajMgr()
     , tbbSync(NULL)
     , ntpSync(NULL)
     , secProcInfo(NULL)
-    , dbIsUp(true)
+    , metricsInfo(NULL)
+    , metricsToWrite(0.)
+    , metricsFileOk(true)
+    , dbService(NULL)
+    , shmIngest(NULL)
+    , replay(NULL)
+    , statusRecorded(false)
+    , dbIsUp(false)
+    , adjWriteReq(0)
+    , gotoReq(0)
     , antennaSelected(false)
     , gotoSet(false)
     , baseUpdTime(1.)
+    , fastUpdTime(0.25)
+    , slowUpdTime(5.)
     , dbThread(0)
+    , dbStop(false)
     , lastGoodMeasID(-1)
+    , residualFile(NULL)
     , lineSpacing(0)
 {
   setObjectName("SatTrajMgr");
+  batchHist = &GenTraj::queryHist(metrics, "batch");
+  goodHist = &GenTraj::queryHist(metrics, "good_samples");
+  frameHist = &metrics.histogram("sattraj_frame_draw_seconds",
+      "Per-frame draw time of all trajectories, CPU side", "", 1e-5, 2., 16);
   configDialog = new SatTrajDialog();
-  if (*localeconv()->decimal_point == ',')
-      changeDecimal = true;
   mysql_library_init(0, NULL, NULL);
 }
 
@@ -164,6 +192,15 @@ void SatTrajMgr::init()
             this, SLOT(resetAdj()));
     connect(gui->getGuiActions("actionNtptimedSync"), SIGNAL(toggled(bool)),
             this, SLOT(changeSyncState(bool)));
+    if (Trace::enabled())
+    {   // сборка с ENABLE_TRACING
+        SATTRAJ_TRACE_THREAD("render");
+        gui->addGuiActions("actionSatTraj_DumpTrace",
+                           "Write trace events to trace_file", "", groupName,
+                           false, false);
+        connect(gui->getGuiActions("actionSatTraj_DumpTrace"),
+                SIGNAL(triggered()), this, SLOT(dumpTrace()));
+    }
 
     // Gui toolbar button
     QString buttonGroup("070-test");
@@ -195,13 +232,29 @@ void SatTrajMgr::init()
 
   // MYSQL initialization
   pthread_mutex_init(&dbLock, NULL);
-  dbIsUp = initMysql(mysql);
+  pthread_mutex_init(&schedLock, NULL);
+  initFeed();
+  dbService = new DbService(this);
+  dbService->start();
+  if (!replay)
+  {   // при воспроизведении БД и разделяемая память не используются
+    dbService->post(DbService::Connect);
+    shmIngest = new ShmIngest;
+    shmIngest->start();
+  }
 
   updAzAdj();
   updZaAdj();
 
-  pthread_cond_init(&dbCv, NULL);
-  if (pthread_create(&dbThread, NULL, callRoutine, this))
+  // сроки планировщика отсчитываются по монотонным часам
+  pthread_condattr_t cvAttr;
+  pthread_condattr_init(&cvAttr);
+  pthread_condattr_setclock(&cvAttr, CLOCK_MONOTONIC);
+  pthread_cond_init(&dbCv, &cvAttr);
+  pthread_condattr_destroy(&cvAttr);
+  setupDbSched();
+  dbStop = false;
+  if (!replay && pthread_create(&dbThread, NULL, callRoutine, this))
   {
       qWarning() << "pthread_create() " << strerror(errno);
       return;
@@ -217,6 +270,35 @@ void SatTrajMgr::init()
     initTraj();
 }
 
+void SatTrajMgr::initFeed(void)
+{
+    if (!feedReplayPath.empty())
+    {
+        if (!feedRecordPath.empty())
+            qWarning() << "SatTrajMgr: feed_record is ignored during replay";
+        try
+        {
+            replay = new FeedReplay(this, feedReplayPath, feedReplaySpeed,
+                                    feedReplayStart);
+        }
+        catch (std::runtime_error &e)
+        {
+            qWarning() << "SatTrajMgr: replay is disabled: " << e.what();
+        }
+        return;
+    }
+    if (feedRecordPath.empty())
+        return;
+    try
+    {
+        feedLog = new FeedLog(feedRecordPath);
+    }
+    catch (std::runtime_error &e)
+    {
+        qWarning() << "SatTrajMgr: recording is disabled: " << e.what();
+    }
+}
+
 void SatTrajMgr::changeSyncState(bool b)
 {
     if (b)
@@ -241,8 +323,8 @@ void SatTrajMgr::loadTex(void)
                createTexture("textures/pointeur5.png");
     arrowTex = StelApp::getInstance().getTextureManager().
                createTexture(":/stell_plug/arrow.png");
-    GoodSample::hintTexture = StelApp::getInstance().getTextureManager().
-               createTexture(":/stell_plug/sample_hint.png");
+    goodSamples.setTexture(StelApp::getInstance().getTextureManager().
+               createTexture(":/stell_plug/sample_hint.png"));
 }
 
 void SatTrajMgr::initTraj(void)
@@ -290,6 +372,44 @@ void SatTrajMgr::initTraj(void)
         traj = pAntTraj;
         objects.append(traj);
     }
+    kickDb();
+    if (replay)
+        replay->start();
+}
+
+void SatTrajMgr::setupDbSched(void)
+{
+    // антенна и измерения обновляются чаще остальных и раньше них
+    dbSched.clear();
+    dbSched.add(5, fastUpdTime, 6);
+    dbSched.add(0, fastUpdTime, 5);
+    dbSched.add(1, baseUpdTime, 4);
+    dbSched.add(3, baseUpdTime, 3);
+    dbSched.add(4, baseUpdTime, 2);
+    dbSched.add(2, slowUpdTime, 1);
+    dbSched.add(goodSamplesSrc, baseUpdTime, 0);
+}
+
+void SatTrajMgr::kickDb(void)
+{
+    if (!dbThread)
+        return;
+    pthread_mutex_lock(&schedLock);
+    dbSched.kick();
+    pthread_cond_signal(&dbCv);
+    pthread_mutex_unlock(&schedLock);
+}
+
+void SatTrajMgr::setDbUpdTime(double t)
+{
+    pthread_mutex_lock(&schedLock);
+    baseUpdTime = t;
+    for (int i = 1; i <= 4; ++i)
+        if (i != 2)
+            dbSched.setPeriod(i, baseUpdTime);
+    dbSched.setPeriod(goodSamplesSrc, baseUpdTime);
+    pthread_cond_signal(&dbCv);
+    pthread_mutex_unlock(&schedLock);
 }
 
 void SatTrajMgr::resetAdj(void)
@@ -323,19 +443,9 @@ void SatTrajMgr::adriveAzDecr(void)
 
 void SatTrajMgr::updAzAdj(void)
 {
-    if (!dbIsUp)
+    if (!dbService)
         return;
-    char buf[1024];
-    snprintf(buf, 1024, "UPDATE adrive_params SET val='%d' WHERE name='Az_adj'",
-             azAdj);
-    if (mysql_query(&mysql,buf))
-    {
-        snprintf(buf,1024,"[%s:%d] Error: can't send query to server:\n\t",
-                 _FILE_,__LINE__);
-        std::string err(buf);
-        err+=mysql_error(&mysql);
-        throw std::runtime_error(err);
-    }
+    adjWriteReq = dbService->post(DbService::WriteAzAdj, azAdj);
     qDebug()<<"updAzAdj()";
 }
 
@@ -359,19 +469,9 @@ void SatTrajMgr::adriveZaDecr(void)
 
 void SatTrajMgr::updZaAdj(void)
 {
-    if (!dbIsUp)
+    if (!dbService)
         return;
-    char buf[1024];
-    snprintf(buf, 1024, "UPDATE adrive_params SET val='%d' WHERE name='Za_adj'",
-             zaAdj);
-    if (mysql_query(&mysql, buf))
-    {
-        snprintf(buf, 1024, "[%s:%d] Error: can't send query to server:\n\t",
-                 _FILE_, __LINE__);
-        std::string err(buf);
-        err+=mysql_error(&mysql);
-        throw std::runtime_error(err);
-    }
+    adjWriteReq = dbService->post(DbService::WriteZaAdj, zaAdj);
     qDebug()<<"updZaAdj()";
 }
 
@@ -413,6 +513,8 @@ void SatTrajMgr::restoreDefaultConfigIni()
   settings->setValue("line5_color", "0,1,1");
   settings->setValue("hint_font_size", 14);
   settings->setValue("db_upd_time", 3.);
+  settings->setValue("db_fast_upd_time", 0.25);
+  settings->setValue("db_slow_upd_time", 5.);
   settings->setValue("db_name", "test");
   settings->setValue("db_user", "root");
   settings->setValue("db_pass", "888");
@@ -422,6 +524,20 @@ void SatTrajMgr::restoreDefaultConfigIni()
   settings->setValue("timeWindow", 240);
   settings->setValue("tw_sample", 5.f);
   settings->setValue("sync_period", 2.f);
+  settings->setValue("combined_fetch", true);
+  settings->setValue("shm_max_points", 200000);
+  settings->setValue("lod_pixel_tol", 0.5);
+  settings->setValue("good_samples_stride", 200);
+  settings->setValue("residual_ref", 1);
+  settings->setValue("residual_csv", "");
+  settings->setValue("feed_record", "");
+  settings->setValue("feed_replay", "");
+  settings->setValue("feed_replay_speed", 1.);
+  settings->setValue("feed_replay_start", 0.);
+  settings->setValue("metrics_hud", false);
+  settings->setValue("metrics_file", "");
+  settings->setValue("metrics_period", 10.);
+  settings->setValue("trace_file", "/tmp/sattraj_trace.json");
 
   settings->endGroup();
 }
@@ -447,7 +563,9 @@ void SatTrajMgr::readSettingsFromConfig()
   messageFont.setPixelSize(settings->value("hint_font_size", 14).toInt());
   lineSpacing = QFontMetrics(messageFont).lineSpacing();
   baseUpdTime = settings->value("db_upd_time", 1.).toDouble();
-  antExtrTime = baseUpdTime*antExtrK;
+  fastUpdTime = settings->value("db_fast_upd_time", 0.25).toDouble();
+  slowUpdTime = settings->value("db_slow_upd_time", 5.).toDouble();
+  antExtrTime = fastUpdTime*antExtrK;
   database = settings->value("db_name", "test").toString().toStdString();
   user = settings->value("db_user", "root").toString().toStdString();
   pass = settings->value("db_pass", "888").toString().toStdString();
@@ -457,6 +575,24 @@ void SatTrajMgr::readSettingsFromConfig()
   timeWindow = settings->value("timeWindow", 240).toUInt();
   timeWindowSamples = settings->value("tw_sample", 5.f).toDouble();
   syncPeriod = settings->value("sync_period", 2.f).toDouble();
+  combinedFetch = settings->value("combined_fetch", true).toBool();
+  shmMaxPoints = settings->value("shm_max_points", 200000).toInt();
+  lodPixelTol = settings->value("lod_pixel_tol", 0.5).toDouble();
+  goodSamplesStride = settings->value("good_samples_stride", 200).toInt();
+  if (goodSamplesStride < 1)
+    goodSamplesStride = 1;
+  residualRef = settings->value("residual_ref", 1).toInt();
+  residualCsv = settings->value("residual_csv", "").toString().toStdString();
+  feedRecordPath = settings->value("feed_record", "").toString().toStdString();
+  feedReplayPath = settings->value("feed_replay", "").toString().toStdString();
+  feedReplaySpeed = settings->value("feed_replay_speed", 1.).toDouble();
+  feedReplayStart = settings->value("feed_replay_start", 0.).toDouble();
+  metricsHud = settings->value("metrics_hud", false).toBool();
+  metricsFile = settings->value("metrics_file", "").toString().toStdString();
+  metricsPeriod = settings->value("metrics_period", 10.).toDouble();
+  if (metricsPeriod < 1.)
+    metricsPeriod = 1.;
+  traceFile = settings->value("trace_file", "/tmp/sattraj_trace.json").toString().toStdString();
 
   settings->endGroup();
 }
@@ -486,6 +622,8 @@ void SatTrajMgr::deinit(void)
                                                       .arg(pAntColor->greenF())
                                                       .arg(pAntColor->blueF()));
   settings->setValue("db_upd_time",baseUpdTime);
+  settings->setValue("db_fast_upd_time", fastUpdTime);
+  settings->setValue("db_slow_upd_time", slowUpdTime);
   settings->setValue("db_name",QString(database.c_str()));
   settings->setValue("db_user",QString(user.c_str()));
   settings->setValue("db_pass",QString(pass.c_str()));
@@ -495,27 +633,67 @@ void SatTrajMgr::deinit(void)
   settings->setValue("timeWindow",timeWindow);
   settings->setValue("tw_sample", timeWindowSamples);
   settings->setValue("sync_period", syncPeriod);
+  settings->setValue("combined_fetch", combinedFetch);
+  settings->setValue("shm_max_points", shmMaxPoints);
+  settings->setValue("lod_pixel_tol", lodPixelTol);
+  settings->setValue("good_samples_stride", goodSamplesStride);
+  settings->setValue("residual_ref", residualRef);
+  settings->setValue("residual_csv", QString(residualCsv.c_str()));
+  settings->setValue("feed_record", QString(feedRecordPath.c_str()));
+  settings->setValue("feed_replay", QString(feedReplayPath.c_str()));
+  settings->setValue("feed_replay_speed", feedReplaySpeed);
+  settings->setValue("feed_replay_start", feedReplayStart);
+  settings->setValue("metrics_hud", metricsHud);
+  settings->setValue("metrics_file", QString(metricsFile.c_str()));
+  settings->setValue("metrics_period", metricsPeriod);
+  settings->setValue("trace_file", QString(traceFile.c_str()));
   settings->endGroup();
   settings = NULL;
 
   delete ntpSync;
   delete secProcInfo;
+  delete metricsInfo;
+  metricsInfo = NULL;
   if (dbThread)
   {
-      pthread_mutex_lock(&dbLock);
-      pthread_cancel(dbThread);
-      pthread_mutex_unlock(&dbLock);
+      pthread_mutex_lock(&schedLock);
+      dbStop = true;
+      pthread_cond_signal(&dbCv);
+      pthread_mutex_unlock(&schedLock);
       pthread_join(dbThread, NULL);
+      dbThread = 0;
+  }
+  delete replay;
+  replay = NULL;
+  if (residualFile)
+  {   // при воспроизведении поток БД не закрывает файл
+      fclose(residualFile);
+      residualFile = NULL;
   }
   pthread_cond_destroy(&dbCv);
+  pthread_mutex_destroy(&schedLock);
   pthread_mutex_destroy(&dbLock);
-  if (dbIsUp)
-  {
-    mysql_close(&mysql);
-    dbIsUp = false;
-  }
-  objects.clear(); // do not call deinitTraj (mutex related issue)
-  GoodSample::hintTexture.clear();
+  delete dbService;
+  dbService = NULL;
+  dbIsUp = false;
+  // не deinitTraj(): dbLock уже уничтожен. Деструкторы MeasTraj и AntTraj
+  // отключают их от shmIngest, поэтому последние ссылки на траектории
+  // освобождаются до его удаления
+  objects.clear();
+  pMeasTraj.clear();
+  pTdTraj.clear();
+  pRefTraj.clear();
+  pEstTraj.clear();
+  pDebugTraj.clear();
+  pAntTraj.clear();
+  delete shmIngest;
+  shmIngest = NULL;
+  delete feedLog;   // после остановки всех записывающих потоков
+  feedLog = NULL;
+  statusRecorded = false;
+  goodSamples.clear();
+  goodSamples.setTexture(StelTextureSP());
+  goodSamplePick.clear();
   lastGoodMeasID = -1;
   delete messageTimer;
   delete pxmapGlow;
@@ -530,29 +708,27 @@ void SatTrajMgr::deinit(void)
 void SatTrajMgr::update(double deltaTime)
 {
     static double time2AdjUpd = baseUpdTime;
-    static double time2TrajUpd = baseUpdTime/6.;
     if (messageFader || messageFader.getInterstate() > 0.f)
         messageFader.update(static_cast<int>(deltaTime*1000));
     if (adjInfoFader || adjInfoFader.getInterstate() > 0.f)
         adjInfoFader.update(static_cast<int>(deltaTime*1000));
+    if (replay)
+    {   // время Stellarium задаётся записью
+        xNtpTime stelT;
+        if (replay->clock(stelT))
+            StelApp::getInstance().getCore()->setJDay(
+                (stelT.doub() - (double)NTP_UNIX_DELTA)/86400. + 2440587.5);
+    }
+    if (flagShowSatTraj && dbService)
+        syncDbState();
     if (flagShowSatTraj && dbIsUp)
     {
         time2AdjUpd -= deltaTime;
-        time2TrajUpd -= deltaTime;
         if (time2AdjUpd < 0.)
         {
             getAdj();
             time2AdjUpd = baseUpdTime;
         }
-        if (time2TrajUpd < 0.)
-        {
-            if (!pthread_mutex_trylock(&dbLock))
-            {
-                pthread_cond_broadcast(&dbCv);
-                pthread_mutex_unlock(&dbLock);
-                time2TrajUpd = baseUpdTime/6.;
-            }
-        }
         if (gotoSet)
             gotoFunc(deltaTime);
         if (secProcInfo)
@@ -560,39 +736,89 @@ void SatTrajMgr::update(double deltaTime)
             secProcInfo->update(deltaTime);
         }
     }
+    if (flagShowSatTraj && metricsInfo)
+        metricsInfo->update(deltaTime);
+    writeMetrics(deltaTime);
 }
 
-void SatTrajMgr::getAdj(void)
+void SatTrajMgr::writeMetrics(double deltaTime)
 {
-    char buf[1024];
-    MYSQL_RES *pRes;
-    MYSQL_ROW row;
-    snprintf(buf,1024,"SELECT name,val FROM adrive_params WHERE name='Az_adj' "
-                      "OR name='Za_adj'");
-    if (mysql_query(&mysql,buf))
+    if (metricsFile.empty())
+        return;
+    metricsToWrite -= deltaTime;
+    if (metricsToWrite > 0.)
+        return;
+    metricsToWrite = metricsPeriod;
+    if (metrics.writeFile(metricsFile))
     {
-        char buf[1024];
-        snprintf(buf,1024,"[%s:%d] Error: can't send query to server:\n\t",
-                 _FILE_,__LINE__);
-        std::string err(buf);
-        err+=mysql_error(&mysql);
-        throw std::runtime_error(err);
+        metricsFileOk = true;
     }
-    pRes = mysql_use_result(&mysql);
-    while ((row = mysql_fetch_row(pRes)))
+    else if (metricsFileOk)
     {
-        if (!strcmp(row[0], "Az_adj"))
-        {
-            azAdj = atoi(row[1]);
-            continue;
-        }
-        if (!strcmp(row[0], "Za_adj"))
+        qWarning() << "SatTrajMgr: can't write" << metricsFile.c_str()
+                   << ":" << strerror(errno);
+        metricsFileOk = false;
+    }
+}
+
+void SatTrajMgr::dumpTrace(void)
+{
+    if (Trace::dump(traceFile.c_str()))
+        qDebug() << "SatTrajMgr: trace written to" << traceFile.c_str();
+    else
+        qWarning() << "SatTrajMgr: can't write" << traceFile.c_str() << ":"
+                   << (Trace::enabled()? strerror(errno): "tracing disabled");
+}
+
+void SatTrajMgr::getAdj(void)
+{
+    if (dbService)
+        dbService->post(DbService::ReadAdj);
+}
+
+void SatTrajMgr::syncDbState(void)
+{
+    if (replay)
+    {
+        FeedLog::StatusRec st;
+        if (!replay->status(st))
+            return;
+        dbIsUp = st.dbUp;
+        if (st.adjValid)
         {
-            zaAdj = atoi(row[1]);
-            continue;
+            azAdj = st.azAdj;
+            zaAdj = st.zaAdj;
         }
+        return;
+    }
+    const DbService::Snapshot &snap = dbService->snapshot();
+    dbIsUp = snap.dbUp;
+    // ответ на чтение, отправленное до последней записи, устарел
+    const bool adjValid = snap.adjValid && snap.done >= adjWriteReq;
+    if (adjValid)
+    {
+        azAdj = snap.azAdj;
+        zaAdj = snap.zaAdj;
     }
-    mysql_free_result(pRes);
+    if (feedLog)
+        recordStatus(adjValid);
+}
+
+void SatTrajMgr::recordStatus(bool adjValid)
+{
+    FeedLog::StatusRec st;
+    st.dbUp = dbIsUp;
+    st.adjValid = adjValid;
+    st.azAdj = azAdj;
+    st.zaAdj = zaAdj;
+    // записываются только изменения
+    if (statusRecorded && !memcmp(&st, &recStatus, sizeof(st)))
+        return;
+    xNtpTime stelT;
+    GenObject::getStelTimeNTP(stelT);
+    feedLog->write(FeedLog::Status, 0, stelT.ext(), &st, sizeof(st));
+    recStatus = st;
+    statusRecorded = true;
 }
 
 void SatTrajMgr::enableSatTrajMgr(bool b)
@@ -604,19 +830,18 @@ void SatTrajMgr::enableSatTrajMgr(bool b)
     {
         tbbSync->setEnabled(true);
         messageTimer->start();
-        if (!dbIsUp)    // try to connect to DB again
-             dbIsUp = initMysql(mysql);
+        if (dbService && !replay)  // try to connect to DB again
+            dbService->post(DbService::Connect);
         if (!objects.empty())
             deinitTraj();
-        if (dbIsUp)
+        if (secProcInfo)
         {
-            if (secProcInfo)
-            {
-                qDebug() << "Warning: secProcInfo still exists";
-                delete secProcInfo;
-            }
-            secProcInfo = new SecProcInfo(this, 2.);
+            qDebug() << "Warning: secProcInfo still exists";
+            delete secProcInfo;
         }
+        secProcInfo = new SecProcInfo(this, 2.);
+        delete metricsInfo;
+        metricsInfo = metricsHud? new MetricsHud(this, 1.): NULL;
         loadTex();
         initTraj();
     }
@@ -655,12 +880,12 @@ void SatTrajMgr::enableSatTrajMgr(bool b)
             delete secProcInfo;
             secProcInfo = NULL;
         }
-        if (dbIsUp)
-        {
-            mysql_close(&mysql);
-            dbIsUp = false;
-        }
+        delete metricsInfo;
+        metricsInfo = NULL;
         setGotoPoint(false);
+        if (dbService)
+            dbService->post(DbService::Disconnect);
+        dbIsUp = false;
         deinitTraj();
     }
 }
@@ -675,6 +900,8 @@ void SatTrajMgr::deinitTraj()
     pEstTraj.clear();
     pDebugTraj.clear();
     pAntTraj.clear();
+    goodSamples.clear();
+    goodSamplePick.clear();
     lastGoodMeasID = -1;
     pthread_mutex_unlock(&dbLock);
 }
@@ -686,6 +913,7 @@ void SatTrajMgr::clearMessage()
 
 void SatTrajMgr::draw(StelCore* core)
 {
+    SATTRAJ_TRACE_SCOPE("SatTrajMgr::draw");
     StelProjectorP prj = core->getProjection(StelCore::FrameAltAz);
     StelPainter painter(prj);
 
@@ -720,6 +948,9 @@ void SatTrajMgr::draw(StelCore* core)
     if (secProcInfo)
         secProcInfo->draw(painter);
 
+    if (metricsInfo)
+        metricsInfo->draw(painter);
+
     if (!flagShowSatTraj)
         return;
 
@@ -739,12 +970,26 @@ void SatTrajMgr::draw(StelCore* core)
     glEnable(GL_BLEND);
     glEnable(GL_LINE_SMOOTH);
 
-    foreach (const GenObjP &traj, objects)
+    // в порядке objects, с учётом времени отрисовки каждой траектории
+    const double t0 = Metrics::monoTime();
+    for (int t = 0; t < 6; ++t)
     {
+        GenTrajP traj = trajByType(t);
         if (traj && traj->isInit())
-            traj->draw(this, prj, painter);
+            traj->drawTimed(this, prj, painter);
     }
 
+    // Draw good samples in the time window
+    if (enableGoodSamples)
+    {
+        xNtpTime stelT;
+        GenObject::getStelTimeNTP(stelT);
+        goodSamples.draw(stelT - xNtpTime((u64)timeWindow << 32),
+                         stelT + xNtpTime((u64)timeWindow << 32), prj, painter,
+                         *pDebugColor, GoodSample::hintSize(prj));
+    }
+    frameHist->observe(Metrics::monoTime() - t0);
+
     // Draw goto point
     if (gotoSet)
     {
@@ -789,6 +1034,10 @@ gotoSetEnd:
             if ((obj->getType() == "GoodSample" || obj->getType() == "SimpleTraj" ||
                  obj->getType() == "AntTraj"))
             {
+                if (obj->getType() == "GoodSample")
+                {   // прокси не рисуется, обновляется только видимость
+                    dynamic_cast<GenObject*>(obj.data())->draw(this, prj, painter);
+                }
                 if (dynamic_cast<GenObject*>(obj.data())->isVisible())
                 {
                     if (obj->getType() == "AntTraj")
@@ -843,7 +1092,6 @@ gotoSetEnd:
 void SatTrajMgr::setGotoPoint(bool b)
 {
     qDebug() <<"setGotoPoint()"<<b;
-    char buf[4096];
     if (b)
     {
         StelCore *core = StelApp::getInstance().getCore();
@@ -858,129 +1106,16 @@ void SatTrajMgr::setGotoPoint(bool b)
             goto finally;
         // Перевод в СК РЛС из внутреннего формата stellarium
         double_point rls;
-        double az_inv_s1, az_inv_s2, az_inv_c1, az_inv_c2;
-        az_inv_s1 = asin(gotoPoint[1]/sqrt(1.-gotoPoint[2]*gotoPoint[2]));
-        if (az_inv_s1 >= 0.)
-            az_inv_s2 = M_PI - az_inv_s1;
-        else
-            az_inv_s2 = -M_PI - az_inv_s1;
-        az_inv_c1 = acos(-gotoPoint[0]/sqrt(1.-gotoPoint[2]*gotoPoint[2]));
-        az_inv_c2 = -az_inv_c1;
-        double diff, min_diff;
-        int min_i = 0;
-        // i == 0
-        min_diff = diff = fabs(az_inv_s1 - az_inv_c1);
-        // i == 1
-        if ((diff = fabs(az_inv_s1 - az_inv_c2)) < min_diff)
-        {
-            min_diff = diff;
-            min_i = 1;
-        }
-        // i == 2
-        if ((diff = fabs(az_inv_s2 - az_inv_c1)) < min_diff)
-        {
-            min_diff = diff;
-            min_i = 2;
-        }
-        // i == 3
-        if ((diff = fabs(az_inv_s2 - az_inv_c2)) < min_diff)
-        {
-            min_diff = diff;
-            min_i = 3;
-        }
-        switch (min_i)
-        {
-            case 0: case 1:
-                rls.first = az_inv_s1;
-                break;
-            case 2: case 3:
-                rls.first = az_inv_s2;
-                break;
-        }
-        rls.second = atan(gotoPoint[2]/sqrt(1.-gotoPoint[2]*gotoPoint[2]));
+        AzElConv::toAzEl(gotoPoint, rls.first, rls.second);
         qDebug()<<"New point RLS:"<<rls.first<<rls.second;
-        // Перевод в СК антенны
-        int_point ant, ant_cur;
-        MYSQL_RES *pRes;
-        MYSQL_ROW row;
-        snprintf(buf,4096,"SELECT name,val FROM adrive_params WHERE "
-                          "name='cur_Az' OR name='cur_Za'");
-        if (mysql_query(&mysql,buf))
-        {
-            snprintf(buf,4096,"[%s:%d] Error: can't send query to server:\n\t",
-                     _FILE_,__LINE__);
-            std::string err(buf);
-            err+=mysql_error(&mysql);
-            throw std::runtime_error(err);
-        }
-        pRes = mysql_use_result(&mysql);
-        while ((row = mysql_fetch_row(pRes)))
-        {
-            if (!strcmp(row[0], "cur_Az"))
-            {
-                ant_cur.first = atoi(row[1]);
-                continue;
-            }
-            if (!strcmp(row[0], "cur_Za"))
-            {
-                ant_cur.second = atoi(row[1]);
-                continue;
-            }
-        }
-        mysql_free_result(pRes);
-        qDebug()<<"Cur point ANT:"<<ant_cur.first<<ant_cur.second;
-        ant = radar2antenna(rls, ant_cur);
-        new_az = ant.first;
-        new_za = ant.second;
-        qDebug()<<"New point ANT:"<<ant.first<<ant.second;
-        // Set new point in DB
-        snprintf(buf, 4096,
-                 "UPDATE adrive_params SET val='%d' WHERE name='new_Az'",
-                 ant.first);
-        if (mysql_query(&mysql,buf))
-        {
-            snprintf(buf,4096,"[%s:%d] Error: can't send query to server:\n\t",
-                     _FILE_,__LINE__);
-            std::string err(buf);
-            err+=mysql_error(&mysql);
-            throw std::runtime_error(err);
-        }
-        snprintf(buf, 4096,
-                 "UPDATE adrive_params SET val='%d' WHERE name='new_Za'",
-                 ant.second);
-        if (mysql_query(&mysql,buf))
-        {
-            snprintf(buf,4096,"[%s:%d] Error: can't send query to server:\n\t",
-                     _FILE_,__LINE__);
-            std::string err(buf);
-            err+=mysql_error(&mysql);
-            throw std::runtime_error(err);
-        }
-        snprintf(buf, 4096,
-                 "UPDATE adrive_params SET val='2' WHERE name='Mode'");
-        if (mysql_query(&mysql,buf))
-        {
-            snprintf(buf,4096,"[%s:%d] Error: can't send query to server:\n\t",
-                     _FILE_,__LINE__);
-            std::string err(buf);
-            err+=mysql_error(&mysql);
-            throw std::runtime_error(err);
-        }
+        // перевод в СК антенны и запись в БД выполняет DbService
+        gotoReq = dbService->post(DbService::SetGoto, 0, rls.first, rls.second);
     }
     else
     {
         if (!dbIsUp)
             goto finally;
-        snprintf(buf, 4096,
-                 "UPDATE adrive_params SET val='1' WHERE name='Mode'");
-        if (mysql_query(&mysql,buf))
-        {
-            snprintf(buf,4096,"[%s:%d] Error: can't send query to server:\n\t",
-                     _FILE_,__LINE__);
-            std::string err(buf);
-            err+=mysql_error(&mysql);
-            throw std::runtime_error(err);
-        }
+        gotoReq = dbService->post(DbService::ClearGoto);
     }
 finally:
     gotoSet = b;
@@ -996,82 +1131,35 @@ void SatTrajMgr::gotoFunc(double delta)
     {
         return;
     }
-    char buf[4096];
-    MYSQL_RES *pRes;
-    MYSQL_ROW row;
-    int_point ant_cur = {0,0};
-    snprintf(buf,4096,"SELECT name,val FROM adrive_params WHERE name='Mode' \
-OR name='cur_Az' OR name='cur_Za' OR name='new_Az' OR name='new_Za'");
-    if (mysql_query(&mysql,buf))
-    {
-        snprintf(buf,4096,"[%s:%d] Error: can't send query to server:\n\t",
-                 _FILE_,__LINE__);
-        std::string err(buf);
-        err+=mysql_error(&mysql);
-        throw std::runtime_error(err);
-    }
-    pRes = mysql_use_result(&mysql);
-    bool changeNewCoord = false;
-    while ((row = mysql_fetch_row(pRes)))
+    dbService->post(DbService::ReadAntenna);
+    time2upd = poll_time;
+    // состояние антенны до выполнения запроса наведения не учитывается
+    const DbService::Snapshot &snap = dbService->snapshot();
+    if (!snap.antValid || snap.done < gotoReq)
+        return;
+    if (snap.mode != 2)
     {
-        if (!strcmp(row[0], "Mode"))
-        {
-            if (atoi(row[1]) != 2)
-            {
-                gotoSet = false;
-                time2upd = 0.;
-                break;
-            }
-        }
-        if (!strcmp(row[0], "cur_Az"))
-        {
-            ant_cur.first = atoi(row[1]);
-            continue;
-        }
-        if (!strcmp(row[0], "cur_Za"))
-        {
-            ant_cur.second = atoi(row[1]);
-            continue;
-        }
-        if (!strcmp(row[0], "new_Az"))
-        {
-            int tmp = atoi(row[1]);
-            if (tmp != new_az)
-            {
-                new_az = tmp;
-                changeNewCoord = true;
-            }
-            continue;
-        }
-        if (!strcmp(row[0], "new_Za"))
-        {
-            int tmp = atoi(row[1]);
-            if (tmp != new_za)
-            {
-                new_za = tmp;
-                changeNewCoord = true;
-            }
-            continue;
-        }
+        gotoSet = false;
+        time2upd = 0.;
+        return;
     }
-    mysql_free_result(pRes);
-    if (changeNewCoord)
+    if (snap.newAz != new_az || snap.newZa != new_za)
     {
         qDebug()<<"changeNewCoord true";
+        new_az = snap.newAz;
+        new_za = snap.newZa;
         int_point ant = {new_az, new_za};
         double_point rls = antenna2radar(ant);
-        gotoPoint = Vec3d(-cos(rls.first), sin(rls.first), tan(rls.second));
-        gotoPoint.normalize();
+        gotoPoint = AzElConv::toVec(rls.first, rls.second);
     }
     double diff;
-    diff = pow(new_az - ant_cur.first, 2) + pow(new_za - ant_cur.second, 2);
+    diff = pow(new_az - snap.curAz, 2) + pow(new_za - snap.curZa, 2);
     qDebug()<<"diff:"<<diff;
 //     if (diff <= delta_sq)
 //     {
 //         setGotoPoint(false);
 //         time2upd = 0.;
 //     }
-    time2upd = poll_time;
 }
 
 void SatTrajMgr::drawAdjInfo(StelCore *core, StelPainter& painter)
@@ -1148,6 +1236,25 @@ QList<StelObjectP> SatTrajMgr::searchAround(const Vec3d& av, double limitFov,
       }
     }
   }
+
+  // прокси создаётся только для ближайшего отсчёта
+  if (enableGoodSamples)
+  {
+    xNtpTime stelT;
+    GenObject::getStelTimeNTP(stelT);
+    GoodSampleStore::Sample s;
+    Vec3d altAz = core->j2000ToAltAz(v);
+    altAz.normalize();
+    if (const_cast<GoodSampleStore&>(goodSamples).nearest(altAz, cosLimFov,
+            stelT - xNtpTime((u64)timeWindow << 32),
+            stelT + xNtpTime((u64)timeWindow << 32), s))
+    {
+      if (!goodSamplePick || !goodSamplePick->isSame(s))
+        goodSamplePick = QSharedPointer<GoodSample>(
+                              new GoodSample("Good sample", pDebugColor, s));
+      result.append(qSharedPointerCast<StelObject>(goodSamplePick));
+    }
+  }
   return result;
 }
 
@@ -1166,6 +1273,8 @@ StelObjectP SatTrajMgr::searchByNameI18n(const QString& nameI18n) const
         return qSharedPointerCast<StelObject>(traj);
     }
   }
+  if (goodSamplePick && goodSamplePick->getNameI18n().toUpper() == nameI18n)
+    return qSharedPointerCast<StelObject>(goodSamplePick);
   return NULL;
 }
 
@@ -1183,6 +1292,9 @@ StelObjectP SatTrajMgr::searchByName(const QString& englishName) const
         return qSharedPointerCast<StelObject>(traj);
     }
   }
+  if (goodSamplePick &&
+      goodSamplePick->getEnglishName().toUpper() == englishName)
+    return qSharedPointerCast<StelObject>(goodSamplePick);
   return NULL;
 }
 
@@ -1206,6 +1318,9 @@ QStringList SatTrajMgr::listMatchingObjectsI18n(const QString& objPrefix,
       }
     }
   }
+  if (goodSamplePick &&
+      goodSamplePick->getNameI18n().toUpper().left(objw.length()) == objw)
+    result << goodSamplePick->getNameI18n().toUpper();
   result.sort();
   if (result.size()>maxNbItem)
       result.erase(result.begin()+maxNbItem, result.end());
@@ -1266,65 +1381,143 @@ void SatTrajMgr::changeSyncPeriod(double newPer)
 
 void* SatTrajMgr::dbRoutine()
 {
-    static int trajNum = 0; // traj number to update
+    SATTRAJ_TRACE_THREAD("db");
+    const double retryPeriod = 2.; // sec
+    std::vector<int> due;
     dbSecondIsUp = false;
-    pthread_cleanup_push(callCleanup, this);
 
-    while (true)
+    pthread_mutex_lock(&schedLock);
+    while (!dbStop)
     {
+        double wakeUp = dbSched.nextDue();
         if (!dbSecondIsUp)
-        {
+        {   // подключение может ждать таймаута, расписание не блокируется
+            pthread_mutex_unlock(&schedLock);
             dbSecondIsUp = initMysql(mysqlSecond);
+            pthread_mutex_lock(&schedLock);
+            if (!dbSecondIsUp)
+                wakeUp = monoTime() + retryPeriod;
         }
-//         qDebug() << "dbRoutine";
-        if (!pthread_mutex_trylock(&dbLock))
+        if (dbSecondIsUp && flagShowSatTraj)
         {
-            pthread_cond_wait(&dbCv, &dbLock);
-            // do DB update
-            if (dbSecondIsUp)
+            due.clear();
+            dbSched.takeDue(monoTime(), due);
+            pthread_mutex_unlock(&schedLock);
+            bool failed = false;
+            if (!due.empty())
             {
-                GenObjP obj;
-                switch (trajNum)
+                pthread_mutex_lock(&dbLock);
+                try
                 {
-                    case 0:
-                        obj = pMeasTraj;
-                        break;
-                    case 1:
-                        obj = pTdTraj;
-                        break;
-                    case 2:
-                        obj = pRefTraj;
-                        break;
-                    case 3:
-                        obj = pEstTraj;
-                        break;
-                    case 4:
-                        obj = pDebugTraj;
-                        break;
-                    case 5:
-                        obj = pAntTraj;
-                        break;
+                    runDue(due);
                 }
-                if (obj && obj->isInit())
+                catch (std::runtime_error &e)
                 {
-                    obj->baseUpdate();
+                    qWarning() << "SatTrajMgr::dbRoutine error: " << e.what();
+                    failed = true;
                 }
-                ++trajNum %= 6;
-            }
-            if (enableGoodSamples && !trajNum)
-            {
-                updGoodSamples();
+                pthread_mutex_unlock(&dbLock);
             }
-            pthread_mutex_unlock(&dbLock);
+            if (failed)
+                dbRoutCleanup();
+            pthread_mutex_lock(&schedLock);
+            if (failed)
+                continue;
+            // kickDb() во время запросов виден здесь как новый срок
+            wakeUp = dbSched.nextDue();
+        }
+        // ожидание срока ближайшего источника или kickDb()
+        if (dbStop)
+            break;
+        if (wakeUp < 0. || (dbSecondIsUp && !flagShowSatTraj))
+        {
+            pthread_cond_wait(&dbCv, &schedLock);
+        }
+        else
+        {
+            struct timespec to;
+            to.tv_sec = (time_t)wakeUp;
+            to.tv_nsec = (long)((wakeUp - to.tv_sec)*1e9);
+            pthread_cond_timedwait(&dbCv, &schedLock, &to);
         }
-        pthread_testcancel();
     }
-    pthread_cleanup_pop(1);
+    pthread_mutex_unlock(&schedLock);
+    dbRoutCleanup();
     return NULL;
 }
 
+void SatTrajMgr::runDue(const std::vector<int> &due)
+{
+    bool dueTraj[6] = {false, false, false, false, false, false};
+    bool goodSamplesDue = false;
+    for (size_t i = 0; i < due.size(); ++i)
+    {
+        if (due[i] == goodSamplesSrc)
+        {
+            goodSamplesDue = true;
+        }
+        else if (combinedFetch)
+        {
+            dueTraj[due[i]] = true;
+        }
+        else
+        {   // в порядке приоритета
+            GenTrajP traj = trajByType(due[i]);
+            if (traj && traj->isInit())
+                traj->baseUpdate();
+        }
+    }
+    if (combinedFetch)
+        batchUpdate(dueTraj);
+    if (goodSamplesDue && enableGoodSamples)
+        updGoodSamples();
+}
+
+GenTrajP SatTrajMgr::trajByType(int type) const
+{
+    switch (type)
+    {
+        case 0:
+            return pMeasTraj;
+        case 1:
+            return pTdTraj;
+        case 2:
+            return pRefTraj;
+        case 3:
+            return pEstTraj;
+        case 4:
+            return pDebugTraj;
+        case 5:
+            return pAntTraj;
+    }
+    return GenTrajP();
+}
+
+double SatTrajMgr::monoTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
 void SatTrajMgr::dbRoutCleanup()
 {
+    goodSampStmt.close();
+    batchStmt.close();
+    // запросы траекторий после mysql_close() остались бы отсоединёнными
+    pthread_mutex_lock(&dbLock);
+    for (int t = 0; t < 6; ++t)
+    {
+        GenTrajP traj = trajByType(t);
+        if (traj)
+            traj->closeDb();
+    }
+    pthread_mutex_unlock(&dbLock);
+    if (residualFile)
+    {
+        fclose(residualFile);
+        residualFile = NULL;
+    }
     if (dbSecondIsUp)
     {
         mysql_close(&mysqlSecond);
@@ -1334,107 +1527,223 @@ void SatTrajMgr::dbRoutCleanup()
 
 void SatTrajMgr::updGoodSamples(void )
 {
-    char query[256];
-    snprintf(query, 256,
-             "SELECT Time,pAz,pUm,Dist,ID FROM InterCnTrack WHERE "
-             "ID>%d AND (ID%%200)=0 ORDER BY ID ASC", lastGoodMeasID);
-    MYSQL_RES *pRes;
-    MYSQL_ROW row;
-    double curAz, curEl, dist;
-    Vec3d pos;
-    xNtpTime time;
-    GenObject::getStelTimeNTP(GoodSample::drawTime);
-    if (mysql_query(&mysqlSecond, query))
+    SATTRAJ_TRACE_SCOPE("SatTrajMgr::updGoodSamples");
+    xNtpTime stelT;
+    if (!goodSampStmt.isPrepared())
     {
-        char buf[1024];
-        snprintf(buf, 1024, "[%s:%d] Error: can't send query to server:\n",
-                 _FILE_, __LINE__);
-        std::string err(buf);
-        err += mysql_error(&mysqlSecond);
-        throw std::runtime_error(err);
+        goodSampStmt.reset();
+        goodSampStmt.prepare(&mysqlSecond,
+                             "SELECT Time,pAz,pUm,Dist,ID FROM InterCnTrack WHERE "
+                             "ID>? AND (ID%?)=0 ORDER BY ID ASC");
+        goodSampStmt.addParam(MYSQL_TYPE_LONG, &lastGoodMeasID);
+        goodSampStmt.addParam(MYSQL_TYPE_LONG, &goodSamplesStride);
+        goodSampStmt.addResult(MYSQL_TYPE_LONGLONG, &gsTime, true);
+        goodSampStmt.addResult(MYSQL_TYPE_DOUBLE, &gsAz);
+        goodSampStmt.addResult(MYSQL_TYPE_DOUBLE, &gsEl);
+        goodSampStmt.addResult(MYSQL_TYPE_DOUBLE, &gsDist);
+        goodSampStmt.addResult(MYSQL_TYPE_LONG, &gsId);
     }
-    pRes = mysql_use_result(&mysqlSecond);
-    while ((row = mysql_fetch_row(pRes)))
+    gsBatch.clear();
+    const double t0 = monoTime();
+    goodSampStmt.execute();
+    while (goodSampStmt.fetch())
     {
-        lastGoodMeasID = atoi(row[4]);
-        if (changeDecimal)
-        {
-            for (register uint i = 0; i < sizeof(row[1]); ++i)
-                if (row[1][i] == '.')
-                    row[1][i] = ',';
-            for (register uint i = 0; i < sizeof(row[2]); ++i)
-                if (row[2][i] == '.')
-                    row[2][i] = ',';
-        }
-        curAz = atof(row[1]);
-        curEl = atof(row[2]);
-        // фикс для расчёта тангенса около пи/2
-        if (curEl >= M_PI_2 - 1e-9)
+        lastGoodMeasID = gsId;
+        gsBatch.append((u64)gsTime, gsAz, gsEl, gsDist);
+    }
+    goodSampStmt.freeResult();
+    goodHist->observe(monoTime() - t0);
+    if (feedLog && !gsBatch.isEmpty())
+    {
+        gsRows.resize(gsBatch.size());
+        for (int i = 0; i < gsBatch.size(); ++i)
         {
-            curEl -= 1e-9;
+            gsRows[i].time = gsBatch.time[i];
+            gsRows[i].az = gsBatch.az[i];
+            gsRows[i].el = gsBatch.el[i];
+            gsRows[i].dist = gsBatch.dist[i];
         }
-        else if (curEl <= -M_PI_2 + 1e-9)
+        GenObject::getStelTimeNTP(stelT);
+        feedLog->write(FeedLog::GoodRows, 0, stelT.ext(), &gsRows[0],
+                       gsRows.size()*sizeof(FeedLog::GoodRow));
+    }
+    processGoodSamples();
+}
+
+void SatTrajMgr::processGoodSamples(void)
+{
+    xNtpTime stelT;
+    GoodSampleStore::Sample sample;
+
+    // невязки всей пачки одним проходом по опорной траектории
+    GenTrajP ref = trajByType(residualRef);
+    if (ref && ref->isInit())
+        ref->residuals(resEngine, gsBatch, gsResid);
+    else
+        gsResid.resize(gsBatch.size());
+    gsVec.resize(gsBatch.size());
+    if (!gsBatch.isEmpty())
+        AzElConv::toVec(&gsBatch.az[0], &gsBatch.el[0], &gsVec[0],
+                        gsBatch.size());
+    for (int i = 0; i < gsBatch.size(); ++i)
+    {
+        sample.t = gsBatch.time[i];
+        sample.pos = gsVec[i];
+        sample.dist = gsBatch.dist[i];
+        sample.dAz = gsResid.valid[i]? gsResid.dAz[i]: 9999.;
+        sample.dEl = gsResid.valid[i]? gsResid.dEl[i]: 9999.;
+        goodSamples.add(sample);
+    }
+    if (!residualCsv.empty() && !gsBatch.isEmpty())
+        writeResiduals();
+
+    // хранятся только отсчёты окна хранения, как у траекторий
+    xNtpTime l_time, r_time;
+    GenObject::getStelTimeNTP(stelT);
+    TrajStore::storeWindow(stelT, timeWindow, l_time, r_time);
+    goodSamples.commit(l_time);
+}
+
+void SatTrajMgr::writeResiduals(void)
+{
+    if (!residualFile)
+    {
+        residualFile = fopen(residualCsv.c_str(), "a");
+        if (!residualFile)
         {
-            curEl += 1e-9;
+            qWarning() << "SatTrajMgr: cannot open residual file"
+                       << residualCsv.c_str() << ":" << strerror(errno);
+            residualCsv.clear();
+            return;
         }
-        time = (u64)strtoull(row[0], NULL, 10);
-        pos = Vec3d(-cos(curAz), sin(curAz), tan(curEl));
-        pos.normalize();
-        dist = atof(row[3]);
-        DataPoint ref = pTdTraj->findByTime(time);
-        double daz = 9999., del = 9999.;
-        if (ref.time != (uint64_t)0)
+        if (ftell(residualFile) == 0)
+            ResidualEngine::writeCsvHeader(residualFile);
+    }
+    ResidualEngine::writeCsv(residualFile, gsBatch, gsResid);
+    fflush(residualFile);
+}
+
+void SatTrajMgr::prepareBatchStmt(void)
+{
+    if (batchStmt.isPrepared() && batchTable == tableName)
+        return;
+    batchStmt.reset();
+    // для каждого типа правая часть (или всё окно) и левая часть окна,
+    // левая часть упорядочивается по убыванию ID
+    std::string query;
+    char buf[512];
+    for (int t = 0; t < 6; ++t)
+    {
+        const char *tbl = t? tableName.c_str(): "InterCnTrack";
+        const char *cols = t? "Az,Um": "pAz,pUm";
+        char typeCond[32] = "";
+        if (t)
+            snprintf(typeCond, 32, "Type=%d AND ", t);
+        snprintf(buf, 512,
+                 "%s(SELECT %d AS Type,0 AS Side,Time,%s,Dist,ID,"
+                 "CAST(ID AS SIGNED) AS Ord FROM %s WHERE %s"
+                 "Time>? AND Time<? AND (ID>? OR Time>?))",
+                 t? " UNION ALL ": "", t, cols, tbl, typeCond);
+        query += buf;
+        snprintf(buf, 512,
+                 " UNION ALL (SELECT %d,1,Time,%s,Dist,ID,-CAST(ID AS SIGNED) "
+                 "FROM %s WHERE %sTime>? AND Time<?)",
+                 t, cols, tbl, typeCond);
+        query += buf;
+    }
+    query += " ORDER BY Type,Side,Ord";
+    batchStmt.prepare(&mysqlSecond, query);
+    for (int t = 0; t < 6; ++t)
+    {
+        batchStmt.addParam(MYSQL_TYPE_LONGLONG, &batchReq[t].rLeft, true);
+        batchStmt.addParam(MYSQL_TYPE_LONGLONG, &batchReq[t].rRight, true);
+        batchStmt.addParam(MYSQL_TYPE_LONG, &batchReq[t].rId);
+        batchStmt.addParam(MYSQL_TYPE_LONGLONG, &batchReq[t].rLast, true);
+        batchStmt.addParam(MYSQL_TYPE_LONGLONG, &batchReq[t].lLeft, true);
+        batchStmt.addParam(MYSQL_TYPE_LONGLONG, &batchReq[t].lRight, true);
+    }
+    batchStmt.addResult(MYSQL_TYPE_LONG, &bType);
+    batchStmt.addResult(MYSQL_TYPE_LONG, &bSide);
+    batchStmt.addResult(MYSQL_TYPE_LONGLONG, &bTime, true);
+    batchStmt.addResult(MYSQL_TYPE_DOUBLE, &bAz);
+    batchStmt.addResult(MYSQL_TYPE_DOUBLE, &bEl);
+    batchStmt.addResult(MYSQL_TYPE_DOUBLE, &bDist);
+    batchStmt.addResult(MYSQL_TYPE_LONG, &bId);
+    batchStmt.addResult(MYSQL_TYPE_LONGLONG, &bOrd);
+    batchTable = tableName;
+}
+
+void SatTrajMgr::batchUpdate(const bool due[6])
+{
+    SATTRAJ_TRACE_SCOPE("SatTrajMgr::batchUpdate");
+    GenTrajP trajs[6];
+    bool active[6];
+    bool any = false;
+    for (int t = 0; t < 6; ++t)
+    {
+        trajs[t] = trajByType(t);
+        active[t] = due[t] && trajs[t] && trajs[t]->isInit() &&
+                    trajs[t]->useDb() && trajs[t]->beginUpdate(batchReq[t]);
+        if (!active[t])
+            batchReq[t].setEmpty();
+        any = any || active[t];
+    }
+    if (!any)
+        return;
+
+    prepareBatchStmt();
+    const double t0 = monoTime();
+    batchStmt.execute();
+    while (batchStmt.fetch())
+    {
+        if (bType >= 0 && bType < 6 && active[bType])
+            trajs[bType]->appendRow(bSide != 0, bTime, bAz, bEl, bDist, bId);
+    }
+    batchStmt.freeResult();
+    batchHist->observe(monoTime() - t0);
+    for (int t = 0; t < 6; ++t)
+        if (active[t])
+            trajs[t]->finishUpdate();
+}
+
+void SatTrajMgr::replayRecord(const FeedLog::RecHeader &h, const void *data)
+{
+    pthread_mutex_lock(&dbLock);
+    switch (h.type)
+    {
+        case FeedLog::DbRows:
         {
-            // Перевод в СК РЛС из внутреннего формата stellarium
-            double ref_az, ref_el;
-            double az_inv_s1, az_inv_s2, az_inv_c1, az_inv_c2;
-            az_inv_s1 = asin(ref.vec[1]/sqrt(1.-ref.vec[2]*ref.vec[2]));
-            if (az_inv_s1 >= 0.)
-                az_inv_s2 = M_PI - az_inv_s1;
-            else
-                az_inv_s2 = -M_PI - az_inv_s1;
-            az_inv_c1 = acos(-ref.vec[0]/sqrt(1.-ref.vec[2]*ref.vec[2]));
-            az_inv_c2 = -az_inv_c1;
-            double diff, min_diff;
-            int min_i = 0;
-            // i == 0
-            min_diff = diff = fabs(az_inv_s1 - az_inv_c1);
-            // i == 1
-            if ((diff = fabs(az_inv_s1 - az_inv_c2)) < min_diff)
-            {
-                min_diff = diff;
-                min_i = 1;
-            }
-            // i == 2
-            if ((diff = fabs(az_inv_s2 - az_inv_c1)) < min_diff)
-            {
-                min_diff = diff;
-                min_i = 2;
-            }
-            // i == 3
-            if ((diff = fabs(az_inv_s2 - az_inv_c2)) < min_diff)
+            GenTrajP traj = trajByType(h.channel);
+            if (traj && traj->isInit() && h.size >= sizeof(FeedLog::DbWindow))
             {
-                min_diff = diff;
-                min_i = 3;
+                const FeedLog::DbWindow *w = (const FeedLog::DbWindow*)data;
+                traj->replayUpdate(*w, (const FeedLog::DbRow*)(w + 1),
+                                   (h.size - sizeof(*w))/sizeof(FeedLog::DbRow));
             }
-            switch (min_i)
-            {
-                case 0: case 1:
-                    ref_az = az_inv_s1;
-                    break;
-                case 2: case 3:
-                    ref_az = az_inv_s2;
-                    break;
-            }
-            ref_el = atan(ref.vec[2]/sqrt(1.-ref.vec[2]*ref.vec[2]));
-
-            daz = (curAz - ref_az)*180.*60./M_PI;
-            del = (curEl - ref_el)*180.*60./M_PI;
+            break;
+        }
+        case FeedLog::GoodRows:
+        {
+            if (!enableGoodSamples)
+                break;
+            const FeedLog::GoodRow *rows = (const FeedLog::GoodRow*)data;
+            gsBatch.clear();
+            for (size_t i = 0; i < h.size/sizeof(FeedLog::GoodRow); ++i)
+                gsBatch.append(rows[i].time, rows[i].az, rows[i].el,
+                               rows[i].dist);
+            processGoodSamples();
+            break;
+        }
+        case FeedLog::ShmBatch:
+        {
+            GenTrajP traj = trajByType(h.channel);
+            ShmIngest::Source *src = dynamic_cast<ShmIngest::Source*>(traj.data());
+            if (src && traj->isInit())
+                src->shmConsume(data, h.size/src->shmRecordSize());
+            break;
         }
-        objects.append(GenObjP(new GoodSample("Good sample", pDebugColor,
-                                              time, pos, dist, daz, del)));
     }
-    mysql_free_result(pRes);
+    pthread_mutex_unlock(&dbLock);
 }
 
 void SatTrajMgr::setEnableShm(bool b)
@@ -1498,26 +1807,14 @@ void NtpSync::draw(StelPainter& painter)
 void NtpSync::resync()
 {
 //     qDebug() << "NtpSync::resync()";
-    if (!mgr->hasDB())
+    if (!mgr->hasDB() || mgr->isReplay())
         return;
 
     // Check whether Ntptimed daemon is running
-    char buf[1024];
-    MYSQL_RES *pRes;
-    MYSQL_ROW row;
-    snprintf(buf, 1024, "SELECT val FROM ntptimed_params WHERE name='Enabled'");
-    if (mysql_query(&mgr->mysql, buf))
-    {
-        snprintf(buf, 1024, "[%s:%d] Error: can't send query to server:\n",
-                 _FILE_, __LINE__);
-        std::string err(buf);
-        err += mysql_error(&mgr->mysql);
-        throw std::runtime_error(err);
-    }
-    pRes = mysql_use_result(&mgr->mysql);
-    row = mysql_fetch_row(pRes);
-    int res = atoi(row[0]);
-    mysql_free_result(pRes);
+    // (используется результат предыдущего запроса)
+    DbService *db = mgr->getDbService();
+    db->post(DbService::ReadNtp);
+    int res = db->snapshot().ntpEnabled;
     switch (res)
     {
         case 0:
@@ -1569,37 +1866,14 @@ void SecProcInfo::update(double deltaTime)
     timeToUpd_ = updPeriod_;
     if (!mgr_->hasDB())
         return;
-//     qDebug()<<"SecProcInfo::update mysql query";
-    char buf[1024] = "SELECT val FROM sec_processing_params WHERE \
-name='Status' OR name='Target' ORDER BY ID ASC";
-    MYSQL_RES *pRes;
-    MYSQL_ROW row;
-    if (mysql_query(&mgr_->mysql, buf))
-    {
-        snprintf(buf, 1024, "[%s:%d] Error: can't send query to server:\n",
-                 _FILE_, __LINE__);
-        std::string err(buf);
-        err += mysql_error(&mgr_->mysql);
-        throw std::runtime_error(err);
-    }
-    pRes = mysql_use_result(&mgr_->mysql);
-    if ((row = mysql_fetch_row(pRes)))
-    {
-        state_.assign(row[0]);
-    }
-    else
-    {
-        state_.assign("MYSQL query error");
-    }
-    if ((row = mysql_fetch_row(pRes)))
-    {
-        target_.assign(row[0]);
-    }
-    else
+    DbService *db = mgr_->getDbService();
+    db->post(DbService::ReadSecProc);
+    const DbService::Snapshot &snap = db->snapshot();
+    if (snap.secValid)
     {
-        target_.assign("MYSQL query error");
+        state_ = snap.secState;
+        target_ = snap.secTarget;
     }
-    mysql_free_result(pRes);
 }
 
 void SecProcInfo::draw(StelPainter& painter)
@@ -1622,3 +1896,114 @@ void SecProcInfo::draw(StelPainter& painter)
                          .arg(state_.c_str()).arg(target_.c_str()));
     }
 }
+
+/* -------------------------------------------------------------------------- */
+
+MetricsHud::MetricsHud(SatTrajMgr* p, double to)
+  : updPeriod_(to)
+  , elapsed_(0.)
+  , mgr_(p)
+{
+    // метрики, которые собирают TrajStore, траектории и SatTrajMgr
+    for (int t = 0; t < 6; ++t)
+    {
+        Source &s = src_[t];
+        s.m = TrajStore::registerMeters(p->metrics, GenTraj::sourceName(t));
+        s.query = &GenTraj::queryHist(p->metrics, GenTraj::sourceName(t));
+        s.points = s.m.shmPoints->value() + s.m.dbPoints->value();
+        s.waitNs = s.m.wait->value();
+        s.m.shmBatch->snapshot(s.batchS);
+        s.m.dbRows->snapshot(s.rowsS);
+        s.query->snapshot(s.queryS);
+        s.m.prep->snapshot(s.prepS);
+        s.m.e2e->snapshot(s.e2eS);
+    }
+    frame_ = &p->getFrameHist();
+    batch_ = &p->getBatchHist();
+    good_ = &p->getGoodHist();
+    frame_->snapshot(frameS_);
+    batch_->snapshot(batchS_);
+    good_->snapshot(goodS_);
+}
+
+void MetricsHud::update(double deltaTime)
+{
+    elapsed_ += deltaTime;
+    if (elapsed_ < updPeriod_)
+        return;
+
+    Metrics::Histogram::Snapshot cur;
+    unsigned long long waitNs = 0;
+    // при совместном запросе время по источникам не измеряется
+    const bool combined = mgr_->combinedFetch;
+    lines_.clear();
+    lines_ << QString("%1%2%3%4%5%6%7").arg("src", -6).arg("pts/s", 8)
+              .arg("held", 8).arg("batch", 7).arg("db,ms", 8)
+              .arg("prep,ms", 8).arg("e2e,ms", 8);
+    for (int t = 0; t < 6; ++t)
+    {
+        Source &s = src_[t];
+        const unsigned long long points = s.m.shmPoints->value() +
+                                          s.m.dbPoints->value();
+        const double rate = (points - s.points)/elapsed_;
+        s.points = points;
+        const unsigned long long w = s.m.wait->value();
+        waitNs += w - s.waitNs;
+        s.waitNs = w;
+
+        // средний размер пачки: из разделяемой памяти, иначе из БД
+        s.m.shmBatch->snapshot(cur);
+        double batch = Metrics::Histogram::mean(s.batchS, cur);
+        s.batchS = cur;
+        s.m.dbRows->snapshot(cur);
+        if (batch == 0.)
+            batch = Metrics::Histogram::mean(s.rowsS, cur);
+        s.rowsS = cur;
+        s.query->snapshot(cur);
+        const double db = s.query->quantile(s.queryS, cur, 0.99);
+        s.queryS = cur;
+        s.m.prep->snapshot(cur);
+        const double prep = s.m.prep->quantile(s.prepS, cur, 0.99);
+        s.prepS = cur;
+        s.m.e2e->snapshot(cur);
+        const double e2e = s.m.e2e->quantile(s.e2eS, cur, 0.5);
+        s.e2eS = cur;
+
+        lines_ << QString("%1%2%3%4%5%6%7").arg(GenTraj::sourceName(t), -6)
+                  .arg(rate, 8, 'f', 0).arg(s.m.held->value(), 8, 'f', 0)
+                  .arg(batch, 7, 'f', 1)
+                  .arg(combined? QString("-"): QString::number(db*1e3, 'f', 1), 8)
+                  .arg(prep*1e3, 8, 'f', 2).arg(e2e*1e3, 8, 'f', 0);
+    }
+    batch_->snapshot(cur);
+    const double batchDb = batch_->quantile(batchS_, cur, 0.99);
+    batchS_ = cur;
+    good_->snapshot(cur);
+    const double goodDb = good_->quantile(goodS_, cur, 0.99);
+    goodS_ = cur;
+    if (combined)
+        lines_ << QString("db p99: batch %1 ms, good samples %2 ms")
+                  .arg(batchDb*1e3, 0, 'f', 1).arg(goodDb*1e3, 0, 'f', 1);
+    else
+        lines_ << QString("db p99: good samples %1 ms")
+                  .arg(goodDb*1e3, 0, 'f', 1);
+    frame_->snapshot(cur);
+    lines_ << QString("frame p99 %1 ms, reader wait %2 ms/s")
+              .arg(frame_->quantile(frameS_, cur, 0.99)*1e3, 0, 'f', 2)
+              .arg(waitNs*1e-6/elapsed_, 0, 'f', 3);
+    frameS_ = cur;
+    elapsed_ = 0.;
+}
+
+void MetricsHud::draw(StelPainter& painter)
+{
+    const StelProjectorP prj = painter.getProjector();
+    QColor c = mgr_->getTextColor();
+    painter.setColor(c.redF(), c.greenF(), c.blueF());
+    painter.setFont(mgr_->getFont());
+    // над строкой NtpSync, последняя строка - ближайшая к ней
+    for (int i = 0; i < lines_.size(); ++i)
+        painter.drawText(prj->getViewportWidth()-mgr_->gWidth,
+                         mgr_->gHeight + (lines_.size() - i)*mgr_->getLineSpacing(),
+                         lines_[i]);
+}
@@ -5,10 +5,18 @@
 #include "GenObject.hpp"
 #include "GenTraj.hpp" // FIXME удалить потом зависимости
 #include "StelFader.hpp"
+#include "DbService.hpp"
+#include "ShmIngest.hpp"
+#include "DbScheduler.hpp"
+#include "GoodSampleStore.hpp"
+#include "FeedLog.hpp"
+#include "StelAdapters.hpp"
+#include "Metrics.hpp"
 
 #include <QtGui/QFont>
 #include <QtGui/QColor>
 #include <QtCore/QPoint>
+#include <QtCore/QStringList>
 #include <pthread.h>
 
 #include <ntptime/ntptime.h>
@@ -19,6 +27,8 @@ class QPixmap;
 class QTimer;
 class QMouseEvent;
 class SatTrajDialog;
+class GoodSample;
+class FeedReplay;
 
 typedef QSharedPointer<GenObject> GenObjP;
 typedef QSharedPointer<GenTraj> GenTrajP;
@@ -60,6 +70,38 @@ public:
     void update(double deltaTime);
 };
 
+/*! \class MetricsHud
+ *  \brief Per-source ingest, DB and draw statistics above NtpSync text.
+ *
+ *  Reads the meters of TrajStore and SatTrajMgr once per update period and
+ *  shows the rates and quantiles over that period. With the combined fetch
+ *  the DB latency is shown for the batch query instead of per source.
+ */
+class MetricsHud
+{
+    struct Source
+    {
+        TrajStore::Meters m;
+        Metrics::Histogram *query;
+        unsigned long long points, waitNs;
+        Metrics::Histogram::Snapshot batchS, rowsS, queryS, prepS, e2eS;
+    };
+
+    const double updPeriod_;
+    double elapsed_;
+    SatTrajMgr *const mgr_;
+    Source src_[6];     // индекс - тип траектории
+    Metrics::Histogram *frame_, *batch_, *good_;
+    Metrics::Histogram::Snapshot frameS_, batchS_, goodS_;
+    QStringList lines_;
+
+public:
+    explicit MetricsHud(SatTrajMgr *p, double to);
+
+    void draw(StelPainter &painter);
+    void update(double deltaTime);
+};
+
 /*! \class SatTrajMgr
  *  \brief This plugin shows satellite and other trajectories.
  *
@@ -106,6 +148,14 @@ class SatTrajMgr : public StelObjectModule
     const QFont& getFont(void) const {return messageFont;}
     int getLineSpacing(void) const {return lineSpacing;}
     bool hasDB(void) const {return dbIsUp;}
+    DbService* getDbService(void) {return dbService;}
+    ShmIngest* getShmIngest(void) {return shmIngest;}
+    //! время совместного запроса, запроса good samples и отрисовки кадра
+    Metrics::Histogram& getBatchHist(void) {return *batchHist;}
+    Metrics::Histogram& getGoodHist(void) {return *goodHist;}
+    Metrics::Histogram& getFrameHist(void) {return *frameHist;}
+    //! initialize MYSQL connection
+    bool initMysql(MYSQL &);
     QColor getMeasTrColor(void) const {return *pMeasColor;}
     QColor getTdTrColor(void) const {return *pTdColor;}
     QColor getRefTrColor(void) const {return *pRefColor;}
@@ -114,8 +164,11 @@ class SatTrajMgr : public StelObjectModule
     QColor getAntTrColor(void) const {return *pAntColor;}
     QColor getTextColor(void) const {return textColor;}
     double getDbUpdTime(void) const {return baseUpdTime;}
-    void setDbUpdTime(double t) {baseUpdTime = t;}
-    void setEnableShm(bool b);
+    void setDbUpdTime(double t);
+    //! данные поступают из записи, а не из БД и разделяемой памяти
+    bool isReplay(void) const {return replay != NULL;}
+    //! apply a recorded trajectory record, called by FeedReplay
+    void replayRecord(const FeedLog::RecHeader &h, const void *data);
 
     std::string database;
     std::string user;
@@ -125,7 +178,6 @@ class SatTrajMgr : public StelObjectModule
     std::string tableName;
     uint timeWindow;
     double timeWindowSamples; // window for primary samples drawing
-    MYSQL mysql;
     MYSQL mysqlSecond;  // used for trajectory update
     int azAdj, zaAdj;   // in ang sec
     int azIncr, zaIncr; // in ang sec
@@ -133,17 +185,34 @@ class SatTrajMgr : public StelObjectModule
     bool antExtr; // use antenna trajectory extrapolation
     const double antExtrK;
     double antExtrTime;
-    bool changeDecimal;
     const int gWidth;
     const int gHeight;
     bool enableGoodSamples;
     bool enableShm;
+    int shmMaxPoints;   // предел числа точек траектории из разделяемой памяти
+    double lodPixelTol; // погрешность упрощения линий в пикселях, 0 - нет
+    bool combinedFetch; // один запрос к БД на все траектории за цикл
+    int goodSamplesStride;  // берётся каждое N-е измерение InterCnTrack
+    int residualRef;        // тип опорной траектории для невязок (1 - ЦУ)
+    std::string residualCsv;    // файл для записи невязок, пусто - нет
+    std::string feedRecordPath; // запись входных данных, пусто - нет
+    std::string feedReplayPath; // воспроизведение записи вместо БД и shm
+    double feedReplaySpeed;     // <= 0 - без ожидания
+    double feedReplayStart;     // смещение от начала записи, с
+    FeedLog *feedLog;           // не NULL во время записи
+    StelTrajClock stelClock;    // время Stellarium для TrajStore
+    Metrics metrics;            // счётчики производительности
+    bool metricsHud;            // показывать MetricsHud
+    std::string metricsFile;    // файл в формате Prometheus, пусто - нет
+    double metricsPeriod;       // период записи metricsFile, с
+    std::string traceFile;      // файл dumpTrace()
 
   signals:
     void changeEnableShm(bool);
 
   public slots:
     void enableSatTrajMgr(bool b);
+    void setEnableShm(bool b);
     void setAzIncr(int val);
     void setZaIncr(int val);
     void changeSyncState(bool b);
@@ -155,6 +224,8 @@ class SatTrajMgr : public StelObjectModule
     void setDebTrColor(QColor c) {*pDebugColor = c;}
     void setAntTrColor(QColor c) {*pAntColor = c;}
     void setTextColor(QColor c) {textColor = c;}
+    //! write trace events of all threads (ENABLE_TRACING builds)
+    void dumpTrace(void);
 
   private slots:
     void clearMessage(void);
@@ -193,29 +264,66 @@ class SatTrajMgr : public StelObjectModule
     StelTextureSP texPointer, arrowTex;
     NtpSync *ntpSync;
     SecProcInfo *secProcInfo;
+    MetricsHud *metricsInfo;
+    double metricsToWrite;  // до записи metricsFile, с
+    bool metricsFileOk;     // предупреждение только о первой ошибке
+    Metrics::Histogram *batchHist, *goodHist;   // запросы к БД
+    Metrics::Histogram *frameHist;  // отрисовка всех траекторий за кадр
+    DbService *dbService;   // запросы к БД из основного потока
+    ShmIngest *shmIngest;   // чтение разделяемой памяти
+    FeedReplay *replay;     // не NULL в режиме воспроизведения
+    bool statusRecorded;
+    FeedLog::StatusRec recStatus;   // последнее записанное состояние
     bool dbIsUp;
+    unsigned int adjWriteReq;   // номер последнего запроса записи поправок
+    unsigned int gotoReq;       // номер последнего запроса наведения
     bool antennaSelected;
     bool gotoSet;
     QPoint gotoXY;
     Vec3d gotoPoint; // in frame StelCore::FrameAltAz
     int new_az, new_za;
     double baseUpdTime; // in sec
+    double fastUpdTime; // период обновления антенны и измерений, sec
+    double slowUpdTime; // период обновления эталонной траектории, sec
     pthread_t dbThread; // поток считывания данных траекторий из БД
-    // для сигнализации необходимости произвести обновление из БД
+    // защищает траектории от удаления во время обновления
     pthread_mutex_t dbLock;
-    // для сигнализации необходимости произвести обновление из БД
+    // защищает dbSched и dbStop, не удерживается во время подключения и
+    // запросов, поэтому kickDb() и setDbUpdTime() не ждут БД
+    pthread_mutex_t schedLock;
+    // будит поток БД при изменении расписания или остановке (со schedLock)
     pthread_cond_t dbCv;
+    DbScheduler dbSched;    // источник - тип траектории или goodSamplesSrc
+    bool dbStop;
+    static const int goodSamplesSrc = 6;
     bool dbSecondIsUp;
     // номер последней полученной точки "хорошего" измерений из БД
-    // FIXME сейчас хранятся все точки
-    // FIXME для отладки в качестве хороших измерений выбирается каждое 200-е
     int lastGoodMeasID;
+    DbStmt goodSampStmt;    // запрос опорных отметок, соединение mysqlSecond
+    unsigned long long gsTime;
+    double gsAz, gsEl, gsDist;
+    int gsId;
+    ResidualEngine resEngine;
+    ResidualEngine::Batch gsBatch;
+    ResidualEngine::Columns gsResid;
+    std::vector<Vec3d> gsVec;
+    std::vector<FeedLog::GoodRow> gsRows;   // пачка для записи в feedLog
+    FILE *residualFile;     // открывается потоком БД при первой записи
+    GoodSampleStore goodSamples;
+    // объект выбранного отсчёта, создаётся в searchAround
+    mutable QSharedPointer<GoodSample> goodSamplePick;
+    // совместный запрос точек всех траекторий, соединение mysqlSecond
+    DbStmt batchStmt;
+    std::string batchTable;
+    DbFetchRange batchReq[6];   // индекс - тип траектории
+    int bType, bSide, bId;
+    unsigned long long bTime;
+    double bAz, bEl, bDist;
+    long long bOrd;
     // GUI
     SatTrajDialog *configDialog;
     int lineSpacing;
 
-    //! initialize MYSQL connection
-    bool initMysql(MYSQL &);
     //! Restore default settings.
     void restoreDefaultConfigIni(void);
     //! Read settings from config.
@@ -223,6 +331,11 @@ class SatTrajMgr : public StelObjectModule
     void updAzAdj(void);
     void updZaAdj(void);
     void getAdj(void);
+    //! apply the latest state published by DbService
+    void syncDbState(void);
+    void recordStatus(bool adjValid);
+    //! create feedLog or replay according to the settings
+    void initFeed(void);
     void drawAdjInfo(StelCore *core, StelPainter& painter);
     void initTraj(void);
     void deinitTraj(void);
@@ -232,10 +345,22 @@ class SatTrajMgr : public StelObjectModule
     void gotoFunc(double);
     void* dbRoutine(void);
     void dbRoutCleanup(void);
+    void setupDbSched(void);
+    //! make all DB sources due and wake the DB thread
+    void kickDb(void);
+    void runDue(const std::vector<int> &due);
+    GenTrajP trajByType(int type) const;
     void updGoodSamples(void);
+    void writeMetrics(double deltaTime);
+    //! residuals and storage of the fetched gsBatch
+    void processGoodSamples(void);
+    void writeResiduals(void);
+    //! update due trajectories with a single query
+    void batchUpdate(const bool due[6]);
+    void prepareBatchStmt(void);
 
+    static double monoTime(void);
     static void* callRoutine(void *arg) {return ((SatTrajMgr*)arg)->dbRoutine();}
-    static void callCleanup(void *arg) {((SatTrajMgr*)arg)->dbRoutCleanup();}
 };
 
 
@@ -0,0 +1,47 @@
+#include "StelAdapters.hpp"
+#include "GenObject.hpp"
+#include "StelPainter.hpp"
+#include "StelProjector.hpp"
+
+#include <QtOpenGL/QtOpenGL>
+
+void StelTrajClock::now(xNtpTime &t) const
+{
+    GenObject::getStelTimeNTP(t);
+}
+
+void StelTrajRender::setColor(float r, float g, float b)
+{
+    painter.enableTexture2d(false);
+    painter.setColor(r, g, b);
+}
+
+void StelTrajRender::lineStrip(const Vec3d *v, int n)
+{
+    if (n < 2)
+        return;
+    glLineWidth(1);
+    painter.setArrays(v);
+    painter.drawFromArray(StelPainter::LineStrip, n);
+    painter.enableClientStates(false);
+}
+
+void StelTrajRender::points(const Vec3d *v, const Vec4f *c, int n, float size)
+{
+    if (!n)
+        return;
+    painter.enableTexture2d(false);
+    painter.setPointSize(size);
+    glEnable(GL_POINT_SMOOTH);
+    painter.setArrays(v);
+    painter.setColorPointer(4, GL_FLOAT, c);
+    painter.enableClientStates(true, false, true);
+    painter.drawFromArray(StelPainter::Points, n);
+    painter.enableClientStates(false);
+    glDisable(GL_POINT_SMOOTH);
+}
+
+double StelTrajRender::pixelPerRad(void) const
+{
+    return painter.getProjector()->getPixelPerRadAtCenter();
+}
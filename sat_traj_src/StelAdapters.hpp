@@ -0,0 +1,38 @@
+#ifndef _STELADAPTERS_HPP_
+#define _STELADAPTERS_HPP_
+
+#include "TrajClock.hpp"
+#include "TrajRender.hpp"
+
+class StelPainter;
+
+/*! \class StelTrajClock
+ *  \brief TrajClock returning the Stellarium model time.
+ */
+class StelTrajClock : public TrajClock
+{
+public:
+    virtual void now(xNtpTime &t) const;
+};
+
+/*! \class StelTrajRender
+ *  \brief TrajRender drawing through a StelPainter of the current frame.
+ */
+class StelTrajRender : public TrajRender
+{
+    StelTrajRender(const StelTrajRender&);
+    const StelTrajRender& operator=(const StelTrajRender&);
+
+public:
+    explicit StelTrajRender(StelPainter &p): painter(p) {}
+
+    virtual void setColor(float r, float g, float b);
+    virtual void lineStrip(const Vec3d *v, int n);
+    virtual void points(const Vec3d *v, const Vec4f *c, int n, float size);
+    virtual double pixelPerRad(void) const;
+
+private:
+    StelPainter &painter;
+};
+
+#endif // _STELADAPTERS_HPP_
@@ -0,0 +1,799 @@
+/* Синтетические замеры производительности модулей SatTrajMgr без
+ * Stellarium, БД и разделяемой памяти.
+ *
+ * sattraj_bench [раздел ...] [-n число_точек] [-r точек_в_с] [-w окно_с]
+ *               [-f кадров] [-m файл_метрик]
+ * Без разделов выполняются все. -r, -w и -f задают поток точек, окно
+ * отрисовки и число кадров разделов pipeline и orbit. С -m раздел
+ * pipeline собирает метрики TrajStore и записывает их в файл в формате
+ * Prometheus (сравнение с запуском без -m - цена метрик). Код возврата 1,
+ * если проверка точности какого-либо раздела не прошла.
+ */
+#include "AzElConv.hpp"
+#include "ResidualEngine.hpp"
+#include "SphereIndex.hpp"
+#include "OrbitSampler.hpp"
+#include "TrajStore.hpp"
+#include "TrajClock.hpp"
+#include "Metrics.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <new>
+#include <vector>
+#include <algorithm>
+
+static double optRate = 1000.;  // точек в секунду на траекторию
+static double optWindow = 240.; // окно отрисовки (timeWindow), с
+static int optFrames = 3600;    // кадров по 1/60 с
+static const char *optMetrics = NULL;   // файл метрик раздела pipeline
+
+// счётчик выделений памяти, бенчмарк однопоточный
+static unsigned long long nAllocs = 0;
+
+void* operator new(size_t size)
+{
+    ++nAllocs;
+    void *p = malloc(size? size: 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) throw()
+{
+    free(p);
+}
+
+void operator delete[](void *p) throw()
+{
+    free(p);
+}
+
+static double monoTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// воспроизводимые псевдослучайные числа в [lo, hi)
+static double uniform(double lo, double hi)
+{
+    return lo + (hi - lo)*(rand()/(RAND_MAX + 1.));
+}
+
+struct Percentiles
+{
+    double p50, p90, p99, max;
+};
+
+static Percentiles percentiles(std::vector<double> v)
+{
+    Percentiles p = {0., 0., 0., 0.};
+    if (v.empty())
+        return p;
+    std::sort(v.begin(), v.end());
+    const size_t n = v.size();
+    p.p50 = v[(n - 1)*50/100];
+    p.p90 = v[(n - 1)*90/100];
+    p.p99 = v[(n - 1)*99/100];
+    p.max = v[n - 1];
+    return p;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// преобразование в том виде, в котором оно было в путях приёма данных
+static Vec3d azElToVecRef(double az, double el)
+{
+    // фикс для расчёта тангенса около пи/2
+    if (el >= M_PI_2 - 1e-9)
+        el -= 1e-9;
+    else if (el <= -M_PI_2 + 1e-9)
+        el += 1e-9;
+    Vec3d v(-cos(az), sin(az), tan(el));
+    v.normalize();
+    return v;
+}
+
+static bool benchAzEl(int n)
+{
+    std::vector<double> az(n), el(n);
+    std::vector<Vec3d> ref(n), out(n);
+    srand(1);
+    for (int i = 0; i < n; ++i)
+    {
+        az[i] = uniform(-2*M_PI, 2*M_PI);
+        el[i] = uniform(-M_PI_2, M_PI_2);
+    }
+    // края диапазона угла места
+    if (n > 2)
+    {
+        el[0] = M_PI_2;
+        el[1] = -M_PI_2;
+    }
+
+    double t = monoTime();
+    for (int i = 0; i < n; ++i)
+        ref[i] = azElToVecRef(az[i], el[i]);
+    const double tRef = monoTime() - t;
+    printf("azel: %d points\n", n);
+    printf("  %-8s %8.2f Mpts/s\n", "tan+norm", n/tRef*1e-6);
+
+    bool ok = true;
+    for (int k = AzElConv::Scalar; k <= AzElConv::Avx2; ++k)
+    {
+        const AzElConv::Kernel kern = (AzElConv::Kernel)k;
+        if (!AzElConv::hasKernel(kern))
+        {
+            printf("  %-8s not supported\n", AzElConv::kernelName(kern));
+            continue;
+        }
+        t = monoTime();
+        AzElConv::toVec(kern, &az[0], &el[0], &out[0], n);
+        const double tk = monoTime() - t;
+        // погрешность относительно прежнего кода и точной формулы с libm
+        double maxErr = 0., maxErrExact = 0.;
+        for (int i = 0; i < n; ++i)
+        {
+            const double e = (out[i] - ref[i]).length();
+            if (e > maxErr)
+                maxErr = e;
+            const double ex = (out[i] - AzElConv::toVec(az[i], el[i])).length();
+            if (ex > maxErrExact)
+                maxErrExact = ex;
+        }
+        // 1e-9 рад - сдвиг угла места прежним кодом около пи/2
+        const bool pass = maxErr < 2e-9 && maxErrExact < 1e-14;
+        ok = ok && pass;
+        printf("  %-8s %8.2f Mpts/s  x%-5.1f err %.3g (old) %.3g (libm) %s\n",
+               AzElConv::kernelName(kern), n/tk*1e-6, tRef/tk, maxErr,
+               maxErrExact, pass? "ok": "FAILED");
+    }
+    printf("  best kernel: %s\n", AzElConv::kernelName(AzElConv::bestKernel()));
+    return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// обратное преобразование в том виде, в котором оно было в SatTrajMgr
+static void vecToAzElRef(const Vec3d &v, double &az, double &el)
+{
+    double az_inv_s1, az_inv_s2, az_inv_c1, az_inv_c2;
+    az_inv_s1 = asin(v[1]/sqrt(1.-v[2]*v[2]));
+    if (az_inv_s1 >= 0.)
+        az_inv_s2 = M_PI - az_inv_s1;
+    else
+        az_inv_s2 = -M_PI - az_inv_s1;
+    az_inv_c1 = acos(-v[0]/sqrt(1.-v[2]*v[2]));
+    az_inv_c2 = -az_inv_c1;
+    double diff, min_diff;
+    int min_i = 0;
+    min_diff = fabs(az_inv_s1 - az_inv_c1);
+    if ((diff = fabs(az_inv_s1 - az_inv_c2)) < min_diff)
+    {
+        min_diff = diff;
+        min_i = 1;
+    }
+    if ((diff = fabs(az_inv_s2 - az_inv_c1)) < min_diff)
+    {
+        min_diff = diff;
+        min_i = 2;
+    }
+    if ((diff = fabs(az_inv_s2 - az_inv_c2)) < min_diff)
+    {
+        min_diff = diff;
+        min_i = 3;
+    }
+    az = min_i < 2? az_inv_s1: az_inv_s2;
+    el = atan(v[2]/sqrt(1.-v[2]*v[2]));
+}
+
+// разность углов с учётом перехода через пи
+static double angleDiff(double a, double b)
+{
+    double d = fabs(a - b);
+    return d > M_PI? 2*M_PI - d: d;
+}
+
+static bool benchAzElInv(int n)
+{
+    std::vector<Vec3d> v(n);
+    std::vector<double> az(n), el(n), azRef(n), elRef(n);
+    srand(2);
+    for (int i = 0; i < n; ++i)
+        v[i] = AzElConv::toVec(uniform(-M_PI, M_PI),
+                               uniform(-M_PI_2 + 1e-3, M_PI_2 - 1e-3));
+
+    double t = monoTime();
+    for (int i = 0; i < n; ++i)
+        vecToAzElRef(v[i], azRef[i], elRef[i]);
+    const double tRef = monoTime() - t;
+    printf("azel_inv: %d points\n", n);
+    printf("  %-8s %8.2f Mpts/s\n", "asin+acos", n/tRef*1e-6);
+
+    bool ok = true;
+    for (int k = AzElConv::Scalar; k <= AzElConv::Avx2; ++k)
+    {
+        const AzElConv::Kernel kern = (AzElConv::Kernel)k;
+        if (!AzElConv::hasKernel(kern))
+        {
+            printf("  %-8s not supported\n", AzElConv::kernelName(kern));
+            continue;
+        }
+        t = monoTime();
+        AzElConv::toAzEl(kern, &v[0], &az[0], &el[0], n);
+        const double tk = monoTime() - t;
+        // прежний код теряет точность около полюса (деление на cos(el))
+        // и около az = +-pi/2 (asin от аргумента около 1), поэтому точность
+        // ядра проверяется по libm atan2
+        double maxErr = 0., maxErrExact = 0.;
+        for (int i = 0; i < n; ++i)
+        {
+            double azx, elx;
+            AzElConv::toAzEl(v[i], azx, elx);
+            maxErr = std::max(maxErr, std::max(angleDiff(az[i], azRef[i]),
+                                               fabs(el[i] - elRef[i])));
+            maxErrExact = std::max(maxErrExact,
+                                   std::max(angleDiff(az[i], azx),
+                                            fabs(el[i] - elx)));
+        }
+        const bool pass = maxErr < 1e-7 && maxErrExact < 1e-14;
+        ok = ok && pass;
+        printf("  %-8s %8.2f Mpts/s  x%-5.1f err %.3g (old) %.3g (libm) %s\n",
+               AzElConv::kernelName(kern), n/tk*1e-6, tRef/tk, maxErr,
+               maxErrExact, pass? "ok": "FAILED");
+    }
+    return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+
+static bool benchResidual(int n)
+{
+    // опорная траектория с шагом 0.1 с и измерения с шагом 0.01 с
+    const int nRef = n/10 + 2;
+    const uint64_t t0 = (uint64_t)3600 << 32, step = ((uint64_t)1 << 32)/100;
+    TrajBuffer ref;
+    for (int i = 0; i < nRef; ++i)
+        ref.append(t0 + step*10*i,
+                   AzElConv::toVec(1e-4*i - M_PI, 0.5 + 1e-5*i), 1e6 + i);
+    ResidualEngine::Batch meas;
+    srand(3);
+    for (int i = 0; i < n; ++i)
+        meas.append(t0 + step*i, 1e-5*i - M_PI + uniform(-1e-3, 1e-3),
+                    0.5 + 1e-6*i + uniform(-1e-3, 1e-3), 1e6 + 0.1*i);
+
+    // прежний способ: поиск с курсором и преобразование для каждой точки
+    std::vector<double> dAz(n), dEl(n);
+    double tRef = 1e9, tm = 1e9;
+    for (int rep = 0; rep < 3; ++rep)
+    {
+        int cursor = -1;
+        double t = monoTime();
+        for (int i = 0; i < n; ++i)
+        {
+            DataPoint p;
+            dAz[i] = dEl[i] = 9999.;
+            if (ref.interpolate(xNtpTime(meas.time[i]), p, &cursor))
+            {
+                double az, el;
+                AzElConv::toAzEl(p.vec, az, el);
+                dAz[i] = (meas.az[i] - az)*180.*60./M_PI;
+                dEl[i] = (meas.el[i] - el)*180.*60./M_PI;
+            }
+        }
+        tRef = std::min(tRef, monoTime() - t);
+    }
+
+    // лучшее из нескольких повторов, буферы движка используются повторно
+    ResidualEngine eng;
+    ResidualEngine::Columns res;
+    int valid = 0;
+    for (int rep = 0; rep < 3; ++rep)
+    {
+        const double t = monoTime();
+        valid = eng.compute(ref, meas, res);
+        tm = std::min(tm, monoTime() - t);
+    }
+
+    double maxErr = 0.;
+    int mismatch = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        if ((dAz[i] != 9999.) != (bool)res.valid[i])
+        {
+            ++mismatch;
+            continue;
+        }
+        if (!res.valid[i])
+            continue;
+        // прежний код не приводит разность азимутов к [-pi, pi]
+        double da = fabs(dAz[i] - res.dAz[i]);
+        da = std::min(da, fabs(da - 360.*60.));
+        maxErr = std::max(maxErr, std::max(da, fabs(dEl[i] - res.dEl[i])));
+    }
+    const bool pass = !mismatch && maxErr < 1e-8;
+    printf("residual: %d measurements, %d reference points, %d valid\n",
+           n, nRef, valid);
+    printf("  %-8s %8.2f Mpts/s\n", "lookup", n/tRef*1e-6);
+    printf("  %-8s %8.2f Mpts/s  x%-5.1f err %.3g ang min %s\n", "merge",
+           n/tm*1e-6, tRef/tm, maxErr, pass? "ok": "FAILED");
+    return pass;
+}
+
+/* -------------------------------------------------------------------------- */
+
+static Vec3d randomDir(void)
+{
+    return AzElConv::toVec(uniform(-M_PI, M_PI), asin(uniform(-1., 1.)));
+}
+
+// запросы конусом 2 градуса, как выбор объекта мышью; n не используется,
+// размеры заданы, чтобы сравнивать с перебором всех объектов
+static bool benchSphere(int /*n*/)
+{
+    const int sizes[] = {1000, 10000, 100000};
+    const int nQuery = 2000;
+    const double cosLim = cos(2.*M_PI/180.);
+    bool ok = true;
+    printf("sphere: %d cone queries, radius 2 deg\n", nQuery);
+    for (size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s)
+    {
+        const int nObj = sizes[s];
+        srand(4);
+        std::vector<Vec3d> pos(nObj), q(nQuery);
+        for (int i = 0; i < nObj; ++i)
+            pos[i] = randomDir();
+        for (int i = 0; i < nQuery; ++i)
+            q[i] = randomDir();
+
+        SphereIndex index;
+        double t = monoTime();
+        for (int i = 0; i < nObj; ++i)
+            index.update(i, pos[i]);
+        const double tBuild = monoTime() - t;
+        // смещение всех точек, как при обновлении кадра
+        for (int i = 0; i < nObj; ++i)
+            pos[i] = pos[i] + Vec3d(1e-3, -1e-3, 1e-3);
+        t = monoTime();
+        for (int i = 0; i < nObj; ++i)
+            index.update(i, pos[i]);
+        const double tMove = monoTime() - t;
+        for (int i = 0; i < nObj; ++i)
+            pos[i].normalize();
+
+        std::vector<int> found, ref;
+        long long nFound = 0, nRef = 0;
+        bool same = true;
+        double tScan = 0., tIndex = 0.;
+        for (int k = 0; k < nQuery; ++k)
+        {
+            ref.clear();
+            t = monoTime();
+            for (int i = 0; i < nObj; ++i)
+                if (pos[i].dot(q[k]) >= cosLim)
+                    ref.push_back(i);
+            tScan += monoTime() - t;
+            found.clear();
+            t = monoTime();
+            index.query(q[k], cosLim, found);
+            tIndex += monoTime() - t;
+            std::sort(found.begin(), found.end());
+            same = same && found == ref;
+            nFound += found.size();
+            nRef += ref.size();
+        }
+        ok = ok && same;
+        printf("  %6d objects: build %.2f ms, move %.2f ms, "
+               "scan %.2f us, index %.2f us  x%-6.1f %lld hits %s\n",
+               nObj, tBuild*1e3, tMove*1e3, tScan/nQuery*1e6,
+               tIndex/nQuery*1e6, tScan/tIndex, nRef, same? "ok": "FAILED");
+    }
+    return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// время кадра в секундах от начала прогона в формате NTP
+static const uint64_t pipeT0 = (uint64_t)3600 << 32;
+
+static uint64_t pipeTime(double sec)
+{
+    return pipeT0 + (uint64_t)(int64_t)floor(sec*4294967296.);
+}
+
+// синтетическое движение объекта
+static void pipeAzEl(double sec, double &az, double &el)
+{
+    az = fmod(1e-2*sec, 2*M_PI) - M_PI;
+    el = 0.6 + 0.3*sin(2e-3*sec);
+}
+
+// модельное время - время кадра
+class PipeClock : public TrajClock
+{
+public:
+    double sec;
+
+    PipeClock(void): sec(0.) {}
+    virtual void now(xNtpTime &t) const {t = xNtpTime(pipeTime(sec));}
+};
+
+// запись синтетического потока в разделяемой памяти
+struct PipeRec
+{
+    uint64_t time;
+    double az, el;
+};
+
+// TrajStore::Decoder для PipeRec, как ShmDecode
+static void pipeDecode(const void *data, const TrajBuffer::Span &out)
+{
+    const PipeRec *in = (const PipeRec*)data;
+    const int chunk = 256;
+    double az[chunk], el[chunk];
+    for (int i0 = 0; i0 < out.size; i0 += chunk)
+    {
+        const int n = std::min(chunk, out.size - i0);
+        for (int i = 0; i < n; ++i)
+        {
+            out.time[i0 + i] = in[i0 + i].time;
+            out.dist[i0 + i] = 1e6;
+            az[i] = in[i0 + i].az;
+            el[i] = in[i0 + i].el;
+        }
+        AzElConv::toVec(az, el, out.vec + i0, n);
+    }
+}
+
+/* Ответ БД на запрос TrajStore::beginUpdate(): точки в моменты k/rate с
+ * ID = pipeIdBase + k (ID в БД положительны, k бывает меньше нуля),
+ * порядок строк как у TrajFetcher. Возвращает число строк.
+ */
+static const long long pipeIdBase = 1LL << 30;
+
+static int pipeDb(TrajStore &store, double rate)
+{
+    DbFetchRange req;
+    if (!store.beginUpdate(req))
+        return 0;
+    int rows = 0;
+    if (req.rRight)
+    {   // Time>rLeft AND Time<rRight AND (ID>rId OR Time>rLast) по возрастанию ID
+        long long k = (long long)floor(((double)req.rLeft - pipeT0)/4294967296.*rate);
+        while (pipeTime(k/rate) <= req.rLeft)
+            ++k;
+        // время растёт вместе с ID, строк с ID <= rId и Time > rLast нет
+        k = std::max(k, req.rId + 1 - pipeIdBase);
+        for (; pipeTime(k/rate) < req.rRight; ++k, ++rows)
+        {
+            double az, el;
+            pipeAzEl(k/rate, az, el);
+            store.appendRow(false, pipeTime(k/rate), az, el, 1e6,
+                            (int)(pipeIdBase + k));
+        }
+    }
+    if (req.lRight)
+    {   // Time>lLeft AND Time<lRight по убыванию ID
+        long long k = (long long)ceil(((double)req.lRight - pipeT0)/4294967296.*rate);
+        while (pipeTime(k/rate) >= req.lRight)
+            --k;
+        for (; pipeTime(k/rate) > req.lLeft; --k, ++rows)
+        {
+            double az, el;
+            pipeAzEl(k/rate, az, el);
+            store.appendRow(true, pipeTime(k/rate), az, el, 1e6,
+                            (int)(pipeIdBase + k));
+        }
+    }
+    store.finishUpdate();
+    return rows;
+}
+
+// одинаковость экземпляров LeftRight после записей
+static bool pipeMirrored(LeftRight<TrajBuffer> &lr)
+{
+    const TrajBuffer &pub = lr.published();
+    const TrajBuffer &standby = lr.beginWrite();
+    bool same = pub.size() == standby.size() && pub.stamp() == standby.stamp();
+    if (same && pub.size())
+        same = pub.timeExt(0) == standby.timeExt(0) &&
+               pub.seq(0) == standby.seq(0) &&
+               pub.timeExt(pub.size() - 1) ==
+               standby.timeExt(standby.size() - 1);
+    lr.endWrite();
+    return same;
+}
+
+/* Кадры по 1/60 с через TrajStore, как у GenTraj: приём измерений и
+ * антенны из разделяемой памяти с потоком optRate, обновление эталонной
+ * траектории из БД раз в секунду,
+ * подготовка кадра (окно, уровни детализации или кэш вершин, отрезок
+ * текущего времени, точки измерений). Задержка и выделения памяти
+ * считаются после первой секунды, когда окно хранения уже заполнено
+ * запросом из БД.
+ */
+static bool benchPipeline(int /*n*/)
+{
+    const double rate = optRate, dtFrame = 1./60.;
+    const unsigned timeWindow = (unsigned)optWindow;
+    const int maxPoints = 200000;       // shm_max_points по умолчанию
+    const double fadeWindow = 5.;       // tw_sample по умолчанию
+    // lod_pixel_tol 0.5 при поле зрения 60 градусов на 1000 пикселей
+    const double tol = 0.5/(1000./(M_PI/3.));
+    const int warmup = 60;
+    xNtpTime storeL, storeR;
+    TrajStore::storeWindow(xNtpTime(pipeT0), timeWindow, storeL, storeR);
+    const double storeHalf = (pipeT0 - storeL.ext())/4294967296.;
+
+    PipeClock clock;
+    FeedLog *const noLog = NULL;
+    TrajStore meas(0, clock, timeWindow, maxPoints, noLog);
+    TrajStore ant(1, clock, timeWindow, maxPoints, noLog);
+    TrajStore ref(2, clock, timeWindow, maxPoints, noLog);
+    Metrics metrics;
+    if (optMetrics)
+    {
+        meas.setMetrics(metrics, "meas");
+        ant.setMetrics(metrics, "ant");
+        ref.setMetrics(metrics, "ref");
+    }
+    TrajStore::Frame antFrame, refFrame;
+    antFrame.lineSize = refFrame.lineSize = 0;
+    MeasPointBatch measBatch;
+    std::vector<PipeRec> recs;
+    long long nShm = 0, nDb = 0;
+    double tShm = 0., tDb = 0., nextDb = 0., maxErr = 0.;
+    std::vector<double> prepLat, frameLat, allocs;
+    prepLat.reserve(optFrames);
+    frameLat.reserve(optFrames);
+    allocs.reserve(optFrames);
+    recs.reserve((size_t)(rate*dtFrame) + 2);
+    // как MeasTraj::attachShm() и AntTraj::attachShm()
+    meas.clear();
+    ant.clear();
+
+    for (int f = 0; f < optFrames; ++f)
+    {
+        const double stelT = f*dtFrame;
+        clock.sec = stelT;
+        const unsigned long long a0 = nAllocs;
+        const double t0 = monoTime();
+
+        // записи с моментами не позже stelT
+        const long long due = (long long)floor(stelT*rate) + 1;
+        const int n = (int)(due - nShm);
+        if (n > 0)
+        {
+            recs.resize(n);
+            for (int i = 0; i < n; ++i)
+            {
+                const double sec = (nShm + i)/rate;
+                recs[i].time = pipeTime(sec);
+                pipeAzEl(sec, recs[i].az, recs[i].el);
+            }
+            meas.appendShm(pipeDecode, &recs[0], n, sizeof(PipeRec));
+            ant.appendShm(pipeDecode, &recs[0], n, sizeof(PipeRec));
+            nShm = due;
+        }
+        const double t1 = monoTime();
+        tShm += t1 - t0;
+        if (stelT >= nextDb)
+        {
+            nDb += pipeDb(ref, rate);
+            nextDb += 1.;
+        }
+        const double t2 = monoTime();
+        tDb += t2 - t1;
+
+        ant.prepare(tol, false, 0., antFrame);
+        if (ref.prepare(tol, false, 0., refFrame))
+        {
+            double az, el;
+            pipeAzEl(stelT, az, el);
+            maxErr = std::max(maxErr, (refFrame.pos - AzElConv::toVec(az, el)).length());
+        }
+        meas.preparePoints(fadeWindow, Vec3f(1.f, 1.f, 1.f), measBatch);
+        const double t3 = monoTime();
+        if (f >= warmup)
+        {
+            prepLat.push_back((t3 - t2)*1e6);
+            frameLat.push_back((t3 - t0)*1e6);
+            allocs.push_back((double)(nAllocs - a0));
+        }
+    }
+
+    // погрешность хорды при шаге 1/rate много меньше 1e-6 рад
+    const bool same = pipeMirrored(meas.draw()) && pipeMirrored(ant.draw()) &&
+                      pipeMirrored(ref.draw());
+    bool pass = same && maxErr < 1e-6;
+    const Percentiles prep = percentiles(prepLat);
+    const Percentiles frame = percentiles(frameLat);
+    const Percentiles al = percentiles(allocs);
+    double allocMean = 0.;
+    for (size_t i = 0; i < allocs.size(); ++i)
+        allocMean += allocs[i];
+    if (!allocs.empty())
+        allocMean /= allocs.size();
+    printf("pipeline: %g pts/s, window %g s (store %g s), %d frames\n",
+           rate, optWindow, 2*storeHalf, optFrames);
+    printf("  %-8s %8.2f Mpts/s  %lld points x2\n", "shm", 2*nShm/tShm*1e-6,
+           nShm);
+    printf("  %-8s %8.2f Mpts/s  %lld rows\n", "db", nDb/tDb*1e-6, nDb);
+    printf("  %-8s p50 %.1f  p90 %.1f  p99 %.1f  max %.1f us  "
+           "(%d + %d line vertices, %d meas points)\n", "prep",
+           prep.p50, prep.p90, prep.p99, prep.max, antFrame.lineSize,
+           refFrame.lineSize, measBatch.size());
+    printf("  %-8s p50 %.1f  p90 %.1f  p99 %.1f  max %.1f us\n", "frame",
+           frame.p50, frame.p90, frame.p99, frame.max);
+    printf("  %-8s mean %.2f  p99 %.0f  max %.0f per frame\n", "allocs",
+           allocMean, al.p99, al.max);
+    if (optMetrics)
+    {   // счётчики поступления совпадают с числом переданных точек
+        const bool counted =
+            TrajStore::registerMeters(metrics, "meas").shmPoints->value() ==
+                (unsigned long long)nShm &&
+            TrajStore::registerMeters(metrics, "ref").dbPoints->value() ==
+                (unsigned long long)nDb;
+        const bool written = metrics.writeFile(optMetrics);
+        printf("  metrics  counters %s, %s %s\n", counted? "match": "DIFFER",
+               optMetrics, written? "written": "NOT written");
+        pass = pass && counted && written;
+    }
+    printf("  interpolation err %.3g rad, mirrored %s: %s\n", maxErr,
+           same? "yes": "no", pass? "ok": "FAILED");
+    return pass;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// круговая орбита с периодом 90 мин
+class PipeOrbit : public OrbitSampler::Model
+{
+public:
+    explicit PipeOrbit(double phase): ph(phase) {}
+
+    virtual void orbitPos(double jd, Vec3d &out) const
+    {
+        const double w = (jd - jd0)*86400.*2*M_PI/5400. + ph;
+        out = AzElConv::toVec(w, 0.5*sin(w));
+    }
+
+    static const double jd0;
+
+private:
+    double ph;
+};
+
+const double PipeOrbit::jd0 = 2456000.5;
+
+/* Линии орбит TleTraj (окно 1200 с, 90 отрезков по умолчанию) для 1000
+ * объектов при разной скорости времени Stellarium; при x10000 за кадр
+ * время сдвигается больше окна и точки вычисляются заново.
+ */
+static bool benchOrbit(int /*n*/)
+{
+    const int nObj = 1000;
+    const unsigned window = 1200, segments = 90;
+    const double speeds[] = {1., 100., 10000., -100.};
+    bool ok = true;
+    printf("orbit: %d objects, window %u s, %u segments, %d frames\n",
+           nObj, window, segments, optFrames);
+    for (size_t s = 0; s < sizeof(speeds)/sizeof(speeds[0]); ++s)
+    {
+        std::vector<PipeOrbit> models;
+        std::vector<OrbitSampler> orbits(nObj);
+        for (int i = 0; i < nObj; ++i)
+            models.push_back(PipeOrbit(2*M_PI*i/nObj));
+        for (int i = 0; i < nObj; ++i)
+            orbits[i].update(models[i], PipeOrbit::jd0, window, segments);
+
+        std::vector<double> lat, allocs;
+        lat.reserve(optFrames);
+        allocs.reserve(optFrames);
+        unsigned long long evals = 0;
+        double jd = PipeOrbit::jd0;
+        for (int f = 0; f < optFrames; ++f)
+        {
+            jd += speeds[s]/60./86400.;
+            const unsigned long long a0 = nAllocs;
+            const double t0 = monoTime();
+            for (int i = 0; i < nObj; ++i)
+                orbits[i].update(models[i], jd, window, segments);
+            lat.push_back((monoTime() - t0)*1e6);
+            allocs.push_back((double)(nAllocs - a0));
+        }
+
+        // каждая точка - положение на момент своей точки окна
+        double maxErr = 0.;
+        for (int i = 0; i < nObj; ++i)
+        {
+            evals += orbits[i].evaluations();
+            for (int k = 0; k < orbits[i].size(); ++k)
+            {
+                Vec3d v;
+                models[i].orbitPos(orbits[i].pointTime(k), v);
+                maxErr = std::max(maxErr, (v - orbits[i].point(k)).length());
+            }
+        }
+        const bool pass = maxErr < 1e-6 && orbits[0].size() == (int)segments + 1;
+        ok = ok && pass;
+        const Percentiles p = percentiles(lat);
+        const Percentiles al = percentiles(allocs);
+        printf("  x%-6g p50 %.1f  p90 %.1f  p99 %.1f  max %.1f us, "
+               "%.1f evals/frame, allocs max %.0f, err %.3g %s\n",
+               speeds[s], p.p50, p.p90, p.p99, p.max,
+               (double)(evals - (unsigned long long)nObj*(segments + 1))/optFrames,
+               al.max, maxErr, pass? "ok": "FAILED");
+    }
+    return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+
+struct Section
+{
+    const char *name;
+    bool (*run)(int n);
+};
+
+static const Section sections[] =
+{
+    {"azel", benchAzEl},
+    {"azel_inv", benchAzElInv},
+    {"residual", benchResidual},
+    {"sphere", benchSphere},
+    {"pipeline", benchPipeline},
+    {"orbit", benchOrbit},
+};
+static const int nSections = sizeof(sections)/sizeof(sections[0]);
+
+int main(int argc, char *argv[])
+{
+    int n = 1000000;
+    std::vector<const char*> names;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            n = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            optRate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+            optWindow = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+            optFrames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            optMetrics = argv[++i];
+        else
+            names.push_back(argv[i]);
+    }
+    if (n < 1)
+        n = 1;
+    if (optRate <= 0.)
+        optRate = 1.;
+    if (optWindow <= 0.)
+        optWindow = 1.;
+    if (optFrames < 1)
+        optFrames = 1;
+
+    bool ok = true;
+    for (int s = 0; s < nSections; ++s)
+    {
+        bool run = names.empty();
+        for (size_t i = 0; i < names.size(); ++i)
+            run = run || !strcmp(names[i], sections[s].name);
+        if (run)
+            ok = sections[s].run(n) && ok;
+    }
+    return ok? 0: 1;
+}
@@ -0,0 +1,368 @@
+/* Имитатор источников разделяемой памяти AntTraj и MeasTraj: создаёт
+ * буферы shmsbuf антенны (SHM_ADDR_ADRIVE_INTER) и отметок
+ * (SHM_ADDR_INTER_BTO_SHMSBUF) и пишет в них пакеты adrive_ext_pac_t и
+ * отметки NeOdnDetectionSampleType пролёта цели в реальном времени.
+ * Запускается до включения модуля, чтобы он подключился к существующим
+ * буферам.
+ *
+ * sattraj_shm_sim [-f meas|ant|both] [-r отметок_в_с] [-a пакетов_в_с]
+ *                 [-b пачка] [-g работа_с,пауза_с] [-R прирост_в_с]
+ *                 [-p пролёт_с] [-e угол_места_град] [-A азимут_град]
+ *                 [-H высота_км] [-s ско_град] [-t длительность_с]
+ *
+ * Пролёт - дуга большого круга от горизонта до горизонта за -p секунд с
+ * наибольшим углом места -e в азимуте -A, дальность - для круговой орбиты
+ * высотой -H. Отметки зашумлены по углам с ско -s, антенна идёт по дуге
+ * без шума. Записи выдаются пачками по -b штук, -g задаёт чередование
+ * выдачи и пауз (пропадание цели), -R - прирост частоты отметок за каждые
+ * 5 с для поиска предельной частоты приёма. Метки времени - текущее
+ * время UTC, поэтому в модуле видна задержка до отрисовки. Каждые 5 с
+ * выводится число выданных записей, ошибок записи и наибольшее отставание
+ * от графика. Ctrl+C - завершение.
+ *
+ * Собирается с опцией CMake ENABLE_SHM_SIM: записи выдаются по одной через
+ * shm_sbuf_write(buf, record), которую модуль не использует, и её
+ * объявление нужно сверить с установленной shmsbuf.
+ */
+#include "AzElConv.hpp"
+#include "xNtpTime.hpp"
+
+#include <shmci/shmsbuf.h>
+#include <shmci/shm_addr.h>
+#include <inter_cn/structs.h>
+#include <coord_conv/CoordConv.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+static const double tick = 1e-3;        // шаг генерации, с
+static const double reportPeriod = 5.;  // с
+static const double earthR = 6371e3;    // м
+
+static volatile sig_atomic_t stopReq = 0;
+
+static void onSignal(int)
+{
+    stopReq = 1;
+}
+
+static double monoTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static double ntpNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9 + (double)NTP_UNIX_DELTA;
+}
+
+// нормальное распределение (Бокс - Мюллер)
+static double gauss(double sigma)
+{
+    const double u1 = (rand() + 1.)/(RAND_MAX + 2.);
+    const double u2 = rand()/(RAND_MAX + 1.);
+    return sigma*sqrt(-2.*log(u1))*cos(2.*M_PI*u2);
+}
+
+/* Дуга пролёта: направление в момент t (с от начала работы) по большому
+ * кругу через точку кульминации c, перпендикулярный ей горизонтальный
+ * вектор d задаёт направление движения. Пролёты повторяются.
+ */
+class Pass
+{
+public:
+    Pass(double period, double maxEl, double culmAz, double height)
+      : per(period)
+      , h(height)
+      , c(AzElConv::toVec(culmAz, maxEl))
+      , d(AzElConv::toVec(culmAz + M_PI_2, 0.))
+    {}
+
+    void at(double t, double &az, double &el, double &dist) const
+    {
+        const double u = (fmod(t, per)/per - 0.5)*M_PI;
+        const Vec3d v = c*cos(u) + d*sin(u);
+        AzElConv::toAzEl(v, az, el);
+        // наклонная дальность до круговой орбиты радиуса earthR + h
+        const double s = sin(el);
+        dist = sqrt((earthR + h)*(earthR + h) - earthR*earthR*(1. - s*s)) -
+               earthR*s;
+    }
+
+private:
+    const double per, h;
+    const Vec3d c, d;
+};
+
+struct Feed
+{
+    const char *name;
+    int key, capacity, recSize;
+    ShmSBuf cont;
+    bool open;
+    double rate;        // записей в секунду
+    double pending;     // накопленная дробная часть
+    int burst;
+    std::vector<char> recs;     // записи текущей пачки
+    int nRecs;
+    unsigned long long published, errors, lastPublished;
+};
+
+static void initFeed(Feed &f, const char *name, int key, int capacity,
+                     int recSize, double rate, int burst)
+{
+    f.name = name;
+    f.key = key;
+    f.capacity = capacity;
+    f.recSize = recSize;
+    f.open = false;
+    f.rate = rate;
+    f.pending = 0.;
+    f.burst = burst;
+    f.recs.resize((size_t)burst*recSize);
+    f.nRecs = 0;
+    f.published = f.errors = f.lastPublished = 0;
+}
+
+static bool openFeed(Feed &f)
+{
+    memset(&f.cont, 0, sizeof(f.cont));
+    const int err = shm_sbuf_init(&f.cont, f.key, f.capacity, f.recSize);
+    if (err < 0)
+    {
+        fprintf(stderr, "%s: shm_sbuf_init() returned %d - %s\n", f.name, err,
+                shm_sbuf_error(err));
+        if ((err == (int)SHM_ERR) || (err == (int)SEM_ERR))
+            fprintf(stderr, "msg from shmsbuf - %s\n", f.cont.err_msg);
+        return false;
+    }
+    if (err == (int)CONN_TO_EXISTING)
+        fprintf(stderr, "%s: buffer already exists, another producer may be "
+                "running\n", f.name);
+    f.open = true;
+    return true;
+}
+
+// выдача накопленной пачки
+static void flushFeed(Feed &f)
+{
+    for (int i = 0; i < f.nRecs; ++i)
+    {
+        if (shm_sbuf_write(&f.cont, &f.recs[(size_t)i*f.recSize]) < 0)
+            ++f.errors;
+        else
+            ++f.published;
+    }
+    f.nRecs = 0;
+}
+
+static void fillMeas(void *rec, double ntp, const Pass &pass, double t,
+                     double sigma)
+{
+    NeOdnDetectionSampleType &smp = *(NeOdnDetectionSampleType*)rec;
+    double az, el, dist;
+    pass.at(t, az, el, dist);
+    memset(&smp, 0, sizeof(smp));
+    xNtpTime(ntp).ntpt(&smp.time);
+    smp.Az = az + gauss(sigma);
+    smp.El = el + gauss(sigma);
+    smp.D = dist;
+}
+
+static void fillAnt(void *rec, double ntp, const Pass &pass, double t,
+                    int_point &antPrev)
+{
+    adrive_ext_pac_t &pac = *(adrive_ext_pac_t*)rec;
+    double az, el, dist;
+    pass.at(t, az, el, dist);
+    double_point rls;
+    rls.first = az;
+    rls.second = el;
+    // обратное к ShmDecode::antPackets, ближайшее к прошлому положению
+    antPrev = radar2antenna(rls, antPrev);
+    memset(&pac, 0, sizeof(pac));
+    xNtpTime(ntp).ntpt(&pac.ts);
+    *(s32*)(&pac.Az) = antPrev.first;
+    *(s32*)(&pac.El) = antPrev.second;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: sattraj_shm_sim [-f meas|ant|both] [-r meas/s] [-a ant/s]\n"
+            "                       [-b burst] [-g on_s,off_s] [-R meas/s per 5 s]\n"
+            "                       [-p pass_s] [-e max_el_deg] [-A az_deg]\n"
+            "                       [-H height_km] [-s sigma_deg] [-t duration_s]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *feeds = "both";
+    double measRate = 1000., antRate = 50., ramp = 0.;
+    double gapOn = 0., gapOff = 0.;
+    double passTime = 600., maxElDeg = 60., culmAzDeg = 180., heightKm = 800.;
+    double sigmaDeg = 0.01, duration = 0.;
+    int burst = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasArg = i + 1 < argc;
+        if (!strcmp(argv[i], "-f") && hasArg)
+            feeds = argv[++i];
+        else if (!strcmp(argv[i], "-r") && hasArg)
+            measRate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-a") && hasArg)
+            antRate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-b") && hasArg)
+            burst = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-g") && hasArg)
+        {
+            if (sscanf(argv[++i], "%lf,%lf", &gapOn, &gapOff) != 2)
+            {
+                usage();
+                return 2;
+            }
+        }
+        else if (!strcmp(argv[i], "-R") && hasArg)
+            ramp = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-p") && hasArg)
+            passTime = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-e") && hasArg)
+            maxElDeg = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-A") && hasArg)
+            culmAzDeg = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-H") && hasArg)
+            heightKm = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && hasArg)
+            sigmaDeg = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-t") && hasArg)
+            duration = atof(argv[++i]);
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    const bool useMeas = strcmp(feeds, "ant") != 0;
+    const bool useAnt = strcmp(feeds, "meas") != 0;
+    if (burst < 1)
+        burst = 1;
+    if (passTime < 1.)
+        passTime = 1.;
+    if (measRate < 0.)
+        measRate = 0.;
+    if (antRate < 0.)
+        antRate = 0.;
+
+    const double d2r = M_PI/180.;
+    const Pass pass(passTime, maxElDeg*d2r, culmAzDeg*d2r, heightKm*1e3);
+    const double sigma = sigmaDeg*d2r;
+    Feed meas, ant;
+    initFeed(meas, "meas", SHM_ADDR_INTER_BTO_SHMSBUF,
+             NeOdnDetectionSamplesBufferCapacity,
+             sizeof(NeOdnDetectionSampleType), measRate, burst);
+    initFeed(ant, "ant", SHM_ADDR_ADRIVE_INTER, ADRIVE_BUF_CAPACITY,
+             sizeof(adrive_ext_pac_t), antRate, burst);
+    if ((useMeas && !openFeed(meas)) || (useAnt && !openFeed(ant)))
+    {
+        if (meas.open)
+            shm_sbuf_deinit(&meas.cont);
+        if (ant.open)
+            shm_sbuf_deinit(&ant.cont);
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    srand(1);
+
+    int_point antPrev;
+    antPrev.first = antPrev.second = 0;
+    const double t0 = monoTime();
+    double tPrev = 0., nextReport = reportPeriod, maxLag = 0.;
+    struct timespec wake;
+    clock_gettime(CLOCK_MONOTONIC, &wake);
+    printf("%8s %10s %10s %10s %8s %8s %10s\n", "t,s", "meas_rate",
+           "meas/s", "ant/s", "errors", "late,ms", "total");
+
+    while (!stopReq && (duration <= 0. || tPrev < duration))
+    {
+        // шаг по абсолютному расписанию, отставание накапливается в dt
+        wake.tv_nsec += (long)(tick*1e9);
+        if (wake.tv_nsec >= 1000000000L)
+        {
+            wake.tv_nsec -= 1000000000L;
+            ++wake.tv_sec;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL);
+        const double t = monoTime() - t0;
+        const double dt = t - tPrev;
+        maxLag = std::max(maxLag, dt - tick);
+        const double ntp = ntpNow();
+
+        const bool silent = gapOff > 0. && fmod(t, gapOn + gapOff) >= gapOn;
+        Feed *const list[2] = {useMeas? &meas: NULL, useAnt? &ant: NULL};
+        for (int k = 0; k < 2; ++k)
+        {
+            Feed *f = list[k];
+            if (!f)
+                continue;
+            f->pending += f->rate*dt;
+            const int n = (int)f->pending;
+            f->pending -= n;
+            if (silent)
+                continue;   // цель потеряна, записей нет
+            // моменты записей равномерно внутри шага
+            for (int i = 0; i < n; ++i)
+            {
+                const double back = dt*(n - 1 - i)/n;
+                void *rec = &f->recs[(size_t)f->nRecs*f->recSize];
+                if (f == &meas)
+                    fillMeas(rec, ntp - back, pass, t - back, sigma);
+                else
+                    fillAnt(rec, ntp - back, pass, t - back, antPrev);
+                if (++f->nRecs == f->burst)
+                    flushFeed(*f);
+            }
+        }
+        tPrev = t;
+
+        if (t >= nextReport)
+        {
+            printf("%8.0f %10.0f %10.0f %10.0f %8llu %8.2f %10llu\n", t,
+                   meas.rate,
+                   (meas.published - meas.lastPublished)/reportPeriod,
+                   (ant.published - ant.lastPublished)/reportPeriod,
+                   meas.errors + ant.errors, maxLag*1e3,
+                   meas.published + ant.published);
+            fflush(stdout);
+            meas.lastPublished = meas.published;
+            ant.lastPublished = ant.published;
+            maxLag = 0.;
+            meas.rate += ramp;
+            nextReport += reportPeriod;
+        }
+    }
+
+    // незаконченные пачки
+    if (useMeas)
+        flushFeed(meas);
+    if (useAnt)
+        flushFeed(ant);
+    printf("published: meas %llu, ant %llu, write errors %llu\n",
+           meas.published, ant.published, meas.errors + ant.errors);
+    if (meas.open)
+        shm_sbuf_deinit(&meas.cont);
+    if (ant.open)
+        shm_sbuf_deinit(&ant.cont);
+    return 0;
+}
@@ -145,7 +145,6 @@ void SatTrajDialog::saveclose(void)
   module->timeWindow = ui->tWin->value();
   module->timeWindowSamples = ui->tw_samples->value();
   module->changeSyncPeriod(ui->sync_period_sb->value());
-  module->antExtrTime = ui->tr_upd->value()*module->antExtrK;
   close();
 }
 
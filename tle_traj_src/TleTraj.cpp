@@ -6,6 +6,7 @@
 #include "StelUtils.hpp"
 #include "TleTraj.hpp"
 #include "TleTrajMgr.hpp"
+#include "Trace.hpp"
 
 #include <QtOpenGL/QtOpenGL>
 
@@ -17,7 +18,7 @@ StelTextureSP TleTraj::hintTexture;
 
 TleTraj::TleTraj():
         isInitialized(false), isVisible(false), orbitColor(NULL), curTime_utc(0.),
-        lastEvalTime(0.), tle(NULL)
+        tle(NULL)
 {
     memset(&curData, 0, sizeof(curData));
 //     qDebug() << "TleTraj inited";
@@ -50,9 +51,10 @@ void TleTraj::draw(const StelCore *core, StelPainter& painter)
 void TleTraj::drawOrbit(StelPainter &painter)
 {
     StelVertexArray vertexArray(StelVertexArray::LineStrip);
-    for (QList<Vec3d>::iterator it = trajectory.begin(); it != trajectory.end(); ++it)
+    vertexArray.vertex.reserve(orbit.size());
+    for (int i = 0; i < orbit.size(); ++i)
     {
-        vertexArray.vertex.append(*it);
+        vertexArray.vertex.append(orbit.point(i));
     }
     painter.setColor(orbitColor->redF(), orbitColor->greenF(), orbitColor->blueF());
     painter.drawGreatCircleArcs(vertexArray, &viewportHalfspace);
@@ -87,6 +89,7 @@ double TleTraj::getAngularSize(const StelCore*) const
 
 void TleTraj::update(void)
 {
+    SATTRAJ_TRACE_SCOPE("TleTraj::update");
     curTime_utc = StelApp::getInstance().getCore()->getJDay();
     sat_position_JD(curTime_utc, location.latitude*M_PI / 180., location.longitude*M_PI / 180.,
                     location.altitude*1e-3, *tle, &curData);
@@ -100,85 +103,22 @@ void TleTraj::satd2StelCoord(const sat_D& src, Vec3d& out) const
     out.normalize();
 }
 
-void TleTraj::computeOrbitPoints(void)
+void TleTraj::orbitPos(double jd, Vec3d &out) const
 {
-    double evalInterval = (double)timeWindow / ((double)orbitLineSegments * 24. * 60. * 60.); // in JD format
-    double orbitHalfSpan = (double)timeWindow / (2. * 24. * 60. * 60.); // in JD format
-    double evalTime;
     sat_D tmp_data;
-    Vec3d tmp_vec;
-    int diffSlots;
+    sat_position_JD(jd, location.latitude*M_PI / 180., location.longitude*M_PI / 180.,
+                    location.altitude*1e-3, *tle, &tmp_data);
+    satd2StelCoord(tmp_data, out);
+}
 
-    if (trajectory.isEmpty())   // Setup trajectory
-    {
-        evalTime  = curTime_utc - orbitHalfSpan;
-        for (uint i = 0; i <= orbitLineSegments; ++i)
-        {
-            sat_position_JD(evalTime, location.latitude*M_PI / 180., location.longitude*M_PI / 180.,
-                            location.altitude*1e-3, *tle, &tmp_data);
-            satd2StelCoord(tmp_data, tmp_vec);
-            trajectory.append(tmp_vec);
-            evalTime += evalInterval;
-        }
-        lastEvalTime = curTime_utc;
-    }
-    else if (curTime_utc > lastEvalTime)
-    { // compute next orbit point when clock runs forward
-        double diffTime = curTime_utc - lastEvalTime;
-        diffSlots = (int)(diffTime * 24. * 60. * 60. * (double)orbitLineSegments / (double)timeWindow);
-        if (diffSlots > 0)
-        {
-            if (diffSlots > (int)orbitLineSegments)
-            {
-                diffSlots = orbitLineSegments + 1;
-                evalTime = curTime_utc - orbitHalfSpan;
-            }
-            else
-            {
-                evalTime   = lastEvalTime + orbitHalfSpan + evalInterval;
-            }
-            for (int i = 0; i < diffSlots; ++i)
-            {  //remove points at beginning of list and add points at end.
-                trajectory.removeFirst();
-                sat_position_JD(evalTime, location.latitude*M_PI / 180., location.longitude*M_PI / 180.,
-                                location.altitude*1e-3, *tle, &tmp_data);
-                satd2StelCoord(tmp_data, tmp_vec);
-                trajectory.append(tmp_vec);
-                evalTime += evalInterval;
-            }
-            lastEvalTime = curTime_utc;
-        }
-    }
-    else if (curTime_utc < lastEvalTime)
-    { // compute next orbit point when clock runs backward
-        double diffTime = lastEvalTime - curTime_utc;
-        diffSlots = (int)(diffTime * 24. * 60. * 60. * (double)orbitLineSegments / (double)timeWindow);
-        if (diffSlots > 0)
-        {
-            if (diffSlots > (int)orbitLineSegments)
-            {
-                diffSlots = orbitLineSegments + 1;
-                evalTime   = curTime_utc + orbitHalfSpan;
-            }
-            else
-            {
-                evalTime   = curTime_utc - orbitHalfSpan - evalInterval;
-            }
-            for (int i = 0; i < diffSlots; ++i)
-            { //remove points at end of list and add points at beginning.
-                trajectory.removeLast();
-                sat_position_JD(evalTime, location.latitude*M_PI / 180., location.longitude*M_PI / 180.,
-                                location.altitude*1e-3, *tle, &tmp_data);
-                satd2StelCoord(tmp_data, tmp_vec);
-                trajectory.push_front(tmp_vec);
-                evalTime -= evalInterval;
-            }
-            lastEvalTime = curTime_utc;
-        }
-    }
+void TleTraj::computeOrbitPoints(void)
+{
+    SATTRAJ_TRACE_SCOPE("TleTraj::computeOrbitPoints");
+    // вычисляются только точки, вошедшие в окно при сдвиге времени
+    orbit.update(*this, curTime_utc, timeWindow, orbitLineSegments);
 }
 
 void TleTraj::recalculateOrbitLines(void)
 {
-    trajectory.clear();
+    orbit.clear();
 }
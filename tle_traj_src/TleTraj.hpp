@@ -5,6 +5,7 @@
 #include "StelObject.hpp"
 #include "StelLocation.hpp"
 #include "StelTextureTypes.hpp"
+#include "OrbitSampler.hpp"
 
 #include <sat_predict/sat_predict.h>
 
@@ -14,7 +15,7 @@ class QColor;
 /*! \class TleTraj
  *  \brief This class represents one trajectory.
  */
-class TleTraj : public StelObject
+class TleTraj : public StelObject, public OrbitSampler::Model
 {
     friend class TleTrajMgr;
     friend class TleFile;
@@ -44,6 +45,8 @@ public:
     virtual Vec3d getJ2000EquatorialPos(const StelCore *core) const;
     virtual double getAngularSize(const StelCore *core) const;
     void update(void);
+    //! OrbitSampler::Model
+    virtual void orbitPos(double jd, Vec3d &out) const;
 
     bool isInitialized;
     bool isVisible;
@@ -54,8 +57,7 @@ private:
     double curTime_utc; // Current JD
     sat_D curData;      // Object current data
     Vec3d XYZ;          // holds J2000 position
-    double lastEvalTime;
-    QList<Vec3d> trajectory; // trajectory points
+    OrbitSampler orbit; // trajectory points
     tle_t *tle; // object's TLE
 
     void draw(const StelCore *core, StelPainter &painter);
@@ -12,8 +12,11 @@
 #include "SolarSystem.hpp"
 #include "TleTrajMgr.hpp"
 #include "TleTrajDialog.hpp"
+#include "Trace.hpp"
 
 #include <QtOpenGL/QtOpenGL>
+#include <errno.h>
+#include <string.h>
 
 StelModule* TleTrajMgrStelPluginInterface::getStelModule() const
 {
@@ -39,9 +42,20 @@ Q_EXPORT_PLUGIN2(TleTrajMgr, TleTrajMgrStelPluginInterface)
 
 TleTrajMgr::TleTrajMgr():
         tleFiles(NULL), flagShowTleTraj(false), pxmapGlow(NULL),
-        pxmapOnIcon(NULL), pxmapOffIcon(NULL), toolbarButton(NULL)
+        pxmapOnIcon(NULL), pxmapOffIcon(NULL), toolbarButton(NULL),
+        metricsHud(false), metricsPeriod(10.), hudElapsed(0.), fileElapsed(0.),
+        metricsFileOk(true)
 {
     tleFiles = new QList<TleFile*>;
+    updHist = &metrics.histogram("tletraj_update_seconds",
+        "Position update time of all visible satellites", "", 1e-5, 2., 16);
+    drawHist = &metrics.histogram("tletraj_draw_seconds",
+        "Per-frame draw time of all visible satellites, CPU side", "",
+        1e-5, 2., 16);
+    visibleGauge = &metrics.gauge("tletraj_visible_objects",
+        "Satellites shown");
+    updCount = &metrics.counter("tletraj_updates_total",
+        "Satellite position updates");
     setObjectName("TleTrajMgr");
     configDialog = new TleTrajDialog(tleFiles);
 }
@@ -147,6 +161,9 @@ void TleTrajMgr::restoreDefaultConfigIni() const
 
     conf->setValue("timeWindow", 1200);
     conf->setValue("segmentsNum", 90);
+    conf->setValue("metrics_hud", false);
+    conf->setValue("metrics_file", "");
+    conf->setValue("metrics_period", 10.);
 
     conf->endGroup();
 }
@@ -158,6 +175,11 @@ void TleTrajMgr::readSettingsFromConfig()
 
     TleTraj::timeWindow = conf->value("timeWindow").toUInt();
     TleTraj::orbitLineSegments = conf->value("segmentsNum").toUInt();
+    metricsHud = conf->value("metrics_hud", false).toBool();
+    metricsFile = conf->value("metrics_file", "").toString().toStdString();
+    metricsPeriod = conf->value("metrics_period", 10.).toDouble();
+    if (metricsPeriod < 1.)
+        metricsPeriod = 1.;
     QStringList keys = conf->allKeys();
     foreach(const QString &key, keys)
     {
@@ -183,6 +205,7 @@ void TleTrajMgr::readSettingsFromConfig()
     }
 
     conf->endGroup();
+    rebuildNameIndex();
 }
 
 void TleTrajMgr::saveConfigOnExit(void)
@@ -192,6 +215,9 @@ void TleTrajMgr::saveConfigOnExit(void)
 
     conf->setValue("timeWindow", TleTraj::timeWindow);
     conf->setValue("segmentsNum", TleTraj::orbitLineSegments);
+    conf->setValue("metrics_hud", metricsHud);
+    conf->setValue("metrics_file", QString(metricsFile.c_str()));
+    conf->setValue("metrics_period", metricsPeriod);
     QStringList keys = conf->allKeys();
     foreach(const QString &key, keys)
     {
@@ -218,21 +244,65 @@ void TleTrajMgr::deinit(void)
         delete tle_file;
     }
     tleFiles->clear();
+    rebuildNameIndex();
 }
 
-void TleTrajMgr::update(double /*deltaTime*/)
+void TleTrajMgr::update(double deltaTime)
 {
+    SATTRAJ_TRACE_SCOPE("TleTrajMgr::update");
+    updateMetrics(deltaTime);
     if (!flagShowTleTraj || StelApp::getInstance().getCore()->getCurrentLocation().planetName != earth->getEnglishName())
         return;
 
+    const double t0 = Metrics::monoTime();
+    int visible = 0;
     foreach(const TleFile *tle_file, *tleFiles)
     {
         foreach(const struct TleFile::tle_obj *tleobj, tle_file->tles)
         {
             if (!tleobj->p.isNull() && tleobj->p->isInitialized && tleobj->p->isVisible)
+            {
                 tleobj->p->update();
+                ++visible;
+            }
         }
     }
+    updHist->observe(Metrics::monoTime() - t0);
+    updCount->add(visible);
+    visibleGauge->set(visible);
+}
+
+void TleTrajMgr::updateMetrics(double deltaTime)
+{
+    hudElapsed += deltaTime;
+    if (metricsHud && hudElapsed >= 1.)
+    {   // квантили за прошедшую секунду
+        Metrics::Histogram::Snapshot upd, draw;
+        updHist->snapshot(upd);
+        drawHist->snapshot(draw);
+        metricsText = QString("TLE: %1 visible, update p99 %2 ms, draw p99 %3 ms")
+                      .arg(visibleGauge->value(), 0, 'f', 0)
+                      .arg(updHist->quantile(updSnap, upd, 0.99)*1e3, 0, 'f', 2)
+                      .arg(drawHist->quantile(drawSnap, draw, 0.99)*1e3, 0, 'f', 2);
+        updSnap = upd;
+        drawSnap = draw;
+        hudElapsed = 0.;
+    }
+
+    fileElapsed += deltaTime;
+    if (metricsFile.empty() || fileElapsed < metricsPeriod)
+        return;
+    fileElapsed = 0.;
+    if (metrics.writeFile(metricsFile))
+    {
+        metricsFileOk = true;
+    }
+    else if (metricsFileOk)
+    {
+        qWarning() << "TleTrajMgr: can't write" << metricsFile.c_str()
+                   << ":" << strerror(errno);
+        metricsFileOk = false;
+    }
 }
 
 void TleTrajMgr::enableTleTrajMgr(bool b)
@@ -243,6 +313,7 @@ void TleTrajMgr::enableTleTrajMgr(bool b)
 
 void TleTrajMgr::draw(StelCore* core)
 {
+    SATTRAJ_TRACE_SCOPE("TleTrajMgr::draw");
     if (!flagShowTleTraj || core->getCurrentLocation().planetName != earth->getEnglishName())
     {
         if (GETSTELMODULE(StelObjectMgr)->getWasSelected())
@@ -260,14 +331,40 @@ void TleTrajMgr::draw(StelCore* core)
     glEnable(GL_BLEND);
     glEnable(GL_LINE_SMOOTH);
     TleTraj::viewportHalfspace = prj->getBoundingCap();
+    const double t0 = Metrics::monoTime();
+    int id = 0;
     foreach(const TleFile *tle_file, *tleFiles)
     {
         foreach(const struct TleFile::tle_obj *tleobj, tle_file->tles)
         {
+            if (id == indexObjs.size())
+                indexObjs.append(TleTrajP());
             if (!tleobj->p.isNull() && tleobj->p->isInitialized && tleobj->p->isVisible)
+            {
                 tleobj->p->draw(core, painter);
+                // ячейка меняется, только если спутник в неё перешёл
+                satIndex.update(id, tleobj->p->XYZ);
+                indexObjs[id] = tleobj->p;
+            }
+            else
+            {
+                satIndex.remove(id);
+                indexObjs[id].clear();
+            }
+            ++id;
         }
     }
+    // спутники удалённых файлов
+    for (int i = id; i < indexObjs.size(); ++i)
+        satIndex.remove(i);
+    indexObjs.resize(id);
+    drawHist->observe(Metrics::monoTime() - t0);
+
+    if (metricsHud && !metricsText.isEmpty())
+    {
+        painter.setColor(0.4f, 0.5f, 0.8f);
+        painter.drawText(10, prj->getViewportHeight() - 40, metricsText);
+    }
 
     // Draw pointer
     if (GETSTELMODULE(StelObjectMgr)->getWasSelected())
@@ -319,27 +416,65 @@ QList<StelObjectP> TleTrajMgr::searchAround(const Vec3d& av, double limitFov, co
     if (!flagShowTleTraj || core->getCurrentLocation().planetName != earth->getEnglishName())
         return result;
 
-    Vec3d v(av);
-    v.normalize();
     double cosLimFov = cos(limitFov * M_PI / 180.);
-    Vec3d pos;
+    std::vector<int> ids;
 
+    // просматриваются только ячейки, пересекающие конус
+    satIndex.query(av, cosLimFov, ids);
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        const TleTrajP &p = indexObjs.at(ids[i]);
+        if (!p.isNull() && p->isInitialized && p->isVisible)
+            result.append(qSharedPointerCast<StelObject>(p));
+    }
+    return result;
+}
+
+void TleTrajMgr::rebuildNameIndex(void)
+{
+    nameIndex.clear();
+    catIndex.clear();
+    nameObjs.clear();
     foreach(const TleFile *tle_file, *tleFiles)
     {
+        if (!tle_file)
+            continue;
         foreach(const struct TleFile::tle_obj *tleobj, tle_file->tles)
         {
-            if (!tleobj->p.isNull() && tleobj->p->isInitialized && tleobj->p->isVisible)
-            {
-                pos = tleobj->p->getJ2000EquatorialPos(core);
-                pos.normalize();
-                if (pos[0]*v[0] + pos[1]*v[1] + pos[2]*v[2] >= cosLimFov)
-                {
-                    result.append(qSharedPointerCast<StelObject>(tleobj->p));
-                }
-            }
+            if (tleobj->p.isNull())
+                continue;
+            const int id = nameObjs.size();
+            nameObjs.append(tleobj->p);
+            nameIndex.add(tleobj->p->getNameI18n(), id);
+            // при повторе номера в нескольких файлах берётся первый
+            if (tleobj->catNum >= 0 && !catIndex.contains(tleobj->catNum))
+                catIndex.insert(tleobj->catNum, id);
         }
     }
-    return result;
+    nameIndex.build();
+}
+
+TleTrajP TleTrajMgr::findByName(const QString &name) const
+{
+    const QString objw = NameIndex::fold(name);
+    // первый видимый из объектов с таким именем
+    for (int i = nameIndex.find(objw); i >= 0 && i < nameIndex.size() &&
+         nameIndex.key(i) == objw; ++i)
+    {
+        const TleTrajP &p = nameObjs.at(nameIndex.id(i));
+        if (p->isInitialized && p->isVisible)
+            return p;
+    }
+    // номер по каталогу NORAD
+    bool isNum = false;
+    const int num = objw.toInt(&isNum);
+    if (isNum && catIndex.contains(num))
+    {
+        const TleTrajP &p = nameObjs.at(catIndex.value(num));
+        if (p->isInitialized && p->isVisible)
+            return p;
+    }
+    return TleTrajP();
 }
 
 StelObjectP TleTrajMgr::searchByNameI18n(const QString& nameI18n) const
@@ -347,18 +482,10 @@ StelObjectP TleTrajMgr::searchByNameI18n(const QString& nameI18n) const
     if (!flagShowTleTraj || StelApp::getInstance().getCore()->getCurrentLocation().planetName != earth->getEnglishName())
         return NULL;
 
-    QString objw = nameI18n.toUpper();
-
-    foreach(const TleFile *tle_file, *tleFiles)
-    {
-        foreach(const struct TleFile::tle_obj *tleobj, tle_file->tles)
-        {
-            if (!tleobj->p.isNull() && tleobj->p->isInitialized && tleobj->p->isVisible)
-                if (tleobj->p->getNameI18n().toUpper() == nameI18n)
-                    return qSharedPointerCast<StelObject>(tleobj->p);
-        }
-    }
-    return NULL;
+    const TleTrajP p = findByName(nameI18n);
+    if (p.isNull())
+        return NULL;
+    return qSharedPointerCast<StelObject>(p);
 }
 
 StelObjectP TleTrajMgr::searchByName(const QString& englishName) const
@@ -366,18 +493,11 @@ StelObjectP TleTrajMgr::searchByName(const QString& englishName) const
     if (!flagShowTleTraj || StelApp::getInstance().getCore()->getCurrentLocation().planetName != earth->getEnglishName())
         return NULL;
 
-    QString objw = englishName.toUpper();
-
-    foreach(const TleFile *tle_file, *tleFiles)
-    {
-        foreach(const struct TleFile::tle_obj *tleobj, tle_file->tles)
-        {
-            if (!tleobj->p.isNull() && tleobj->p->isInitialized && tleobj->p->isVisible)
-                if (tleobj->p->getEnglishName().toUpper() == englishName)
-                    return qSharedPointerCast<StelObject>(tleobj->p);
-        }
-    }
-    return NULL;
+    // имена TLE не переводятся
+    const TleTrajP p = findByName(englishName);
+    if (p.isNull())
+        return NULL;
+    return qSharedPointerCast<StelObject>(p);
 }
 
 QStringList TleTrajMgr::listMatchingObjectsI18n(const QString& objPrefix,
@@ -389,20 +509,17 @@ QStringList TleTrajMgr::listMatchingObjectsI18n(const QString& objPrefix,
     if (maxNbItem == 0)
         return result;
 
-    QString objw = objPrefix.toUpper();
+    const QString objw = NameIndex::fold(objPrefix);
 
-    foreach(const TleFile *tle_file, *tleFiles)
+    // ключи упорядочены, первые maxNbItem видимых и есть ответ
+    for (int i = nameIndex.lowerBound(objw);
+         nameIndex.hasPrefix(i, objw) && result.size() < maxNbItem; ++i)
     {
-        foreach(const struct TleFile::tle_obj *tleobj, tle_file->tles)
-        {
-            if (!tleobj->p.isNull() && tleobj->p->isInitialized && tleobj->p->isVisible)
-                if (tleobj->p->getNameI18n().toUpper().left(objw.length()) == objw)
-                    result << tleobj->p->getNameI18n().toUpper();
-        }
+        const TleTrajP &p = nameObjs.at(nameIndex.id(i));
+        if (p->isInitialized && p->isVisible &&
+            (result.isEmpty() || result.last() != nameIndex.key(i)))
+            result << nameIndex.key(i);
     }
-    result.sort();
-    if (result.size() > maxNbItem)
-        result.erase(result.begin() + maxNbItem, result.end());
     return result;
 }
 
@@ -443,6 +560,7 @@ TleFile::TleFile(const QString& _file): QStandardItem(_file), file(_file)
         tmp_struct = new struct tle_obj;
         memcpy(&tmp_struct->tle, &new_tle[i], sizeof(tmp_struct->tle));
         tmp_struct->color = QColor(Qt::darkGray);
+        tmp_struct->catNum = -1;
         tmp_struct->firstTimeVis = true;
         tmp_struct->item = StdItemP(new QStandardItem(QVariant(i).toString()+" "+QString(tmp_struct->tle.sat_name)));
         tmp_struct->item->setCheckable(false);
@@ -472,6 +590,18 @@ TleFile::TleFile(const QString& _file): QStandardItem(_file), file(_file)
     {
         file_contents << in.readLine();
     }
+
+    // номер NORAD - колонки 3-7 строки 1, объекты идут в порядке файла
+    int k = 0;
+    foreach(const QString &line, file_contents)
+    {
+        if (k < tles.size() && line.startsWith("1 ") && line.length() >= 7)
+        {
+            bool ok = false;
+            const int num = line.mid(2, 5).trimmed().toInt(&ok);
+            tles[k++]->catNum = ok? num: -1;
+        }
+    }
 }
 
 TleFile::~TleFile()
@@ -5,6 +5,9 @@
 #include "StelLocation.hpp"
 #include "StelTextureTypes.hpp"
 #include "TleTraj.hpp"
+#include "SphereIndex.hpp"
+#include "NameIndex.hpp"
+#include "Metrics.hpp"
 
 #include <QtGui/QColor>
 #include <QtGui/QStandardItemModel>
@@ -45,6 +48,7 @@ public:
         TleTrajP p;
         StdItemP item;
         QColor color;
+        int catNum;         // номер NORAD из строки 1 TLE, -1 - неизвестен
         bool firstTimeVis;  // true if has never been visible, false after isVisible=true for first time
     };
     QString file;
@@ -107,6 +111,8 @@ public:
         return TleTraj::timeWindow;
     }
     void setSegmentsNum(uint newNum);
+    //! Rebuild name and catalog number indices after TLE files change.
+    void rebuildNameIndex(void);
     uint getSegmentsNum(void) const
     {
         return TleTraj::orbitLineSegments;
@@ -129,6 +135,28 @@ private:
     QSharedPointer<Planet> earth;
     // GUI
     TleTrajDialog *configDialog;
+    // положения видимых спутников для searchAround, номер - порядковый
+    // номер спутника в tleFiles при последней отрисовке
+    SphereIndex satIndex;
+    QVector<TleTrajP> indexObjs;
+    // поиск по имени и номеру NORAD, номер - индекс в nameObjs
+    NameIndex nameIndex;
+    QHash<int, int> catIndex;
+    QVector<TleTrajP> nameObjs;
+    // счётчики производительности, текст на экране и файл Prometheus
+    Metrics metrics;
+    Metrics::Histogram *updHist, *drawHist;
+    Metrics::Gauge *visibleGauge;
+    Metrics::Counter *updCount;
+    bool metricsHud;
+    std::string metricsFile;    // пусто - не записывается
+    double metricsPeriod;       // с
+    double hudElapsed, fileElapsed;     // с момента обновления текста и файла
+    bool metricsFileOk;
+    QString metricsText;
+    Metrics::Histogram::Snapshot updSnap, drawSnap;
+
+    TleTrajP findByName(const QString &name) const;
 
     //! Restore default settings.
     void restoreDefaultConfigIni(void) const;
@@ -137,6 +165,8 @@ private:
     void saveConfigOnExit(void);
     void drawPointer(StelCore *core, StelPainter &painter) const;
     void recalculateOrbitLines(void);
+    //! refresh metricsText and write metricsFile
+    void updateMetrics(double deltaTime);
 };
 
 
@@ -95,6 +95,7 @@ void TleTrajDialog::addFile(const QString &new_file)
         }
         tleFiles->append(tmp);
         fillBranch(tleFiles->last());
+        GETSTELMODULE(TleTrajMgr)->rebuildNameIndex();
     }
     else
     {
@@ -111,6 +112,7 @@ void TleTrajDialog::removeFile(void)
     if (item->type() == QStandardItem::UserType) // tle file selected
     {
         tleFiles->removeOne(dynamic_cast<TleFile*>(item));
+        GETSTELMODULE(TleTrajMgr)->rebuildNameIndex();
         smodel.invisibleRootItem()->removeRow(item->row());
     }
 }